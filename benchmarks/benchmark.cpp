@@ -3,10 +3,29 @@
 // Compile: g++ -std=c++11 -O2 -DNDEBUG -I.. benchmark.cpp -o benchmark
 
 #include "../vita/format.hpp"
+#include "../vita/alloc_output.hpp"
+#include "../vita/async_logger.hpp"
+#include "../vita/batch.hpp"
+#include "../vita/binlog.hpp"
+#include "../vita/csv_writer.hpp"
+#include "../vita/json.hpp"
+#include "../vita/logfmt.hpp"
+#include "../vita/print.hpp"
+#include "../vita/segmented_output.hpp"
+#if !defined(_WIN32)
+#include "../vita/async_sink.hpp"
+#include "../vita/file_writer.hpp"
+#include "../vita/mmap_output.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include <chrono>
 #include <iostream>
 #include <cstdio>
 #include <sstream>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 using Clock = std::chrono::high_resolution_clock;
 
@@ -36,6 +55,35 @@ void escape(const std::string& s) {
     if (!s.empty()) sink = s[0];
 }
 
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+// Stack usage: paint a region below the caller, run the call at the same
+// depth, then count how much of the paint it overwrote
+const std::size_t STACK_PROBE = 32768;
+
+BENCH_NOINLINE void paint_stack() {
+    volatile char region[STACK_PROBE];
+    for (std::size_t i = 0; i < STACK_PROBE; ++i) region[i] = 0x5a;
+}
+
+BENCH_NOINLINE std::size_t painted_stack_used() {
+    volatile char region[STACK_PROBE];
+    std::size_t i = 0;
+    while (i < STACK_PROBE && region[i] == 0x5a) ++i;
+    return STACK_PROBE - i;
+}
+
+template <typename Func>
+void stack_usage(const char* name, Func func) {
+    paint_stack();
+    func();
+    std::cout << name << ": " << painted_stack_used() << " bytes of stack\n";
+}
+
 int main() {
     const int ITERATIONS = 1000000;
 
@@ -160,6 +208,357 @@ int main() {
         sink = buf[0];
     });
 
+    std::cout << "\n--- format_view ---\n";
+
+    benchmark("Vita::format(int, double, string)", ITERATIONS, []() {
+        escape(Vita::format("request {} took {}ms for {}", 12345, 3.2, "a fairly long instrument name"));
+    });
+
+    benchmark("Vita::format_view(int, double, string)", ITERATIONS, []() {
+        sink = Vita::format_view("request {} took {}ms for {}", 12345, 3.2, "a fairly long instrument name").data[0];
+    });
+
+    benchmark("Vita::format(\"user:{}:{}\", ...) key", ITERATIONS, []() {
+        escape(Vita::format("user:{}:{}", 12345, "session"));
+    });
+
+    benchmark("Vita::format_fixed<64>(\"user:{}:{}\", ...) key", ITERATIONS, []() {
+        sink = Vita::format_fixed<64>("user:{}:{}", 12345, "session").data[0];
+    });
+
+#ifdef VITA_FORMAT_HAS_MAX_SIZE
+    std::cout << "\n--- sized stack buffer ---\n";
+
+    benchmark("Vita::formatc(\"{}:{:x}:{:.3f}\", ...)", ITERATIONS, []() {
+        escape(Vita::formatc("{}:{:x}:{:.3f}", 12345, 0xdeadbeefu, 3.25));
+    });
+
+    benchmark("VITA_FORMAT_SIZED(\"{}:{:x}:{:.3f}\", ...)", ITERATIONS, []() {
+        sink = VITA_FORMAT_SIZED("{}:{:x}:{:.3f}", 12345, 0xdeadbeefu, 3.25).data[0];
+    });
+#endif
+
+    std::cout << "\n--- large output (4 KiB) ---\n";
+
+    {
+        std::string body(4000, 'x');
+        benchmark("Vita::format(...) 4 KiB", ITERATIONS / 10, [&body]() {
+            escape(Vita::format("{}:{}\n", 12345, body));
+        });
+        benchmark("Vita::format_buffer(...) 4 KiB", ITERATIONS / 10, [&body]() {
+            sink = Vita::format_buffer("{}:{}\n", 12345, body).data()[0];
+        });
+        benchmark("VITA_FORMAT(...) 4 KiB (adaptive reserve)", ITERATIONS / 10, [&body]() {
+            escape(VITA_FORMAT("{}:{}\n", 12345, body));
+        });
+    }
+
+    std::cout << "\n--- output block pool (VITA_FORMAT_POOL) ---\n";
+
+    {
+        benchmark("new[]/delete[] 4 KiB block", ITERATIONS, []() {
+            char* p = new char[4096];
+            p[0] = 'x';
+            sink = p[0];
+            delete[] p;
+        });
+        benchmark("pool_allocate/pool_free 4 KiB block", ITERATIONS, []() {
+            std::size_t cap = 4096;
+            char* p = Vita::detail::pool_allocate(cap);
+            if (!p) p = new char[cap];
+            p[0] = 'x';
+            sink = p[0];
+            Vita::detail::pool_free(p, cap);
+        });
+        Vita::trim_pool();
+    }
+
+#ifdef VITA_FORMAT_HAS_PMR
+    std::cout << "\n--- per-request arena (pmr) ---\n";
+
+    {
+        std::string body(400, 'x');
+        benchmark("Vita::format(...) 400 B", ITERATIONS, [&body]() {
+            escape(Vita::format("{}:{}", 12345, body));
+        });
+        static char arena[4096];
+        benchmark("Vita::pmr::format(monotonic, ...) 400 B", ITERATIONS, [&body]() {
+            std::pmr::monotonic_buffer_resource mr(arena, sizeof(arena));
+            std::pmr::string s = Vita::pmr::format(&mr, "{}:{}", 12345, body);
+            sink = s[0];
+        });
+    }
+#endif
+
+    std::cout << "\n--- request builder (40 fragments) ---\n";
+
+    benchmark("std::string += Vita::format(...)", ITERATIONS / 10, []() {
+        std::string req;
+        for (int i = 0; i < 40; ++i)
+            req += Vita::format("&k{}={}", i, i * 7);
+        escape(req);
+    });
+
+    benchmark("Vita::format_append(std::string&, ...)", ITERATIONS / 10, []() {
+        std::string req;
+        for (int i = 0; i < 40; ++i)
+            Vita::format_append(req, "&k{}={}", i, i * 7);
+        escape(req);
+    });
+
+    std::cout << "\n--- JSON ---\n";
+
+    benchmark("Vita::formatc JSON object", ITERATIONS, []() {
+        escape(Vita::formatc("{{\"id\":{},\"v\":{},\"name\":\"{:j}\"}}", 12345, 3.14, "vita"));
+    });
+
+    benchmark("Vita::JsonWriter object", ITERATIONS, []() {
+        Vita::JsonWriter w;
+        w.begin_object().key("id").value(12345).key("v").value(3.14)
+         .key("name").value("vita").end_object();
+        escape(w.finish());
+    });
+
+    std::cout << "\n--- logfmt ---\n";
+
+    benchmark("Vita::formatc logfmt line", ITERATIONS, []() {
+        escape(Vita::formatc("level={} msg=\"{:j}\" latency_ms={}", "info", "request done", 3.2));
+    });
+
+    benchmark("Vita::KeySet logfmt line", ITERATIONS, []() {
+        static const Vita::KeySet<3> keys("level", "msg", "latency_ms");
+        escape(keys.format("info", "request done", 3.2));
+    });
+
+    std::cout << "\n--- print to FILE* ---\n";
+
+#if defined(_WIN32)
+    std::FILE* devnull = std::fopen("NUL", "w");
+#else
+    std::FILE* devnull = std::fopen("/dev/null", "w");
+#endif
+    if (devnull) {
+        benchmark("fputs(Vita::format(...).c_str())", ITERATIONS, [devnull]() {
+            std::fputs(Vita::format("request {} took {}ms\n", 12345, 3.2).c_str(), devnull);
+        });
+
+        benchmark("Vita::print(FILE*, ...)", ITERATIONS, [devnull]() {
+            Vita::print(devnull, "request {} took {}ms\n", 12345, 3.2);
+        });
+
+        std::fclose(devnull);
+    }
+
+    std::cout << "\n--- async logging (caller side) ---\n";
+
+    {
+        // one burst that fits in the default ring, so the caller never waits
+        const int ASYNC_ITERATIONS = 3000;
+        Vita::AsyncLogger log([](const char*, std::size_t) {});
+        std::string name = "instrument";
+        benchmark("AsyncLogger::log(int, double, string)", ASYNC_ITERATIONS, [&log, &name]() {
+            log.log("request {} took {}ms for {}", 12345, 3.2, name);
+        });
+        benchmark("Vita::format(int, double, string)", ASYNC_ITERATIONS, [&name]() {
+            escape(Vita::format("request {} took {}ms for {}", 12345, 3.2, name));
+        });
+    }
+
+    std::cout << "\n--- binary logging ---\n";
+
+    {
+        std::FILE* f = std::tmpfile();
+        if (f) {
+            std::string name = "instrument";
+            {
+                Vita::BinlogWriter log(f);
+                benchmark("VITA_BINLOG(int, double, string)", ITERATIONS, [&log, &name]() {
+                    VITA_BINLOG(log, "request {} took {}ms for {}", 12345, 3.2, name);
+                });
+            }
+            long binary = std::ftell(f);
+            std::size_t text = Vita::format("request {} took {}ms for {}\n", 12345, 3.2, name).size();
+            std::cout << "bytes per event: " << static_cast<double>(binary) / (ITERATIONS + ITERATIONS / 10)
+                      << " binary vs " << text << " text\n";
+            std::fclose(f);
+        }
+    }
+
+#if !defined(_WIN32)
+    std::cout << "\n--- log file (one line per call) ---\n";
+
+    const char* log_path = "/tmp/vita_bench.log";
+    int log_fd = ::open(log_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (log_fd >= 0) {
+        benchmark("Vita::println(fd, ...)", ITERATIONS, [log_fd]() {
+            Vita::println(log_fd, "request {} took {}ms", 12345, 3.2);
+        });
+        ::close(log_fd);
+    }
+    std::remove(log_path);
+
+    {
+        Vita::FileWriter log(log_path);
+        benchmark("Vita::FileWriter::writeln", ITERATIONS, [&log]() {
+            log.writeln("request {} took {}ms", 12345, 3.2);
+        });
+    }
+    std::remove(log_path);
+
+    for (int uring = 1; uring >= 0; --uring) {
+        Vita::AsyncSinkOptions opts;
+        opts.io_uring = uring != 0;
+        Vita::AsyncSink sink(log_path, opts);
+        std::string name = std::string("Vita::AsyncSink::println (") +
+                           (sink.backend() == Vita::BACKEND_IO_URING ? "io_uring" : "pwrite thread") + ")";
+        benchmark(name.c_str(), ITERATIONS, [&sink]() {
+            sink.println("request {} took {}ms", 12345, 3.2);
+        });
+        sink.flush();
+    }
+    std::remove(log_path);
+
+    std::cout << "\n--- bulk export ---\n";
+
+    {
+        Vita::detail::FormatOutput out;
+        benchmark("format_to(FormatOutput)", ITERATIONS, [&out]() {
+            Vita::format_to(out, "{},{},{:.3f}\n", 12345, "name", 3.25);
+        });
+        std::FILE* f = std::fopen(log_path, "wb");
+        if (f) {
+            std::fwrite(out.data(), 1, out.size(), f);
+            std::fclose(f);
+        }
+    }
+    std::remove(log_path);
+
+    {
+        Vita::SegmentedOutput out;
+        benchmark("format_to(SegmentedOutput)", ITERATIONS, [&out]() {
+            Vita::format_to(out, "{},{},{:.3f}\n", 12345, "name", 3.25);
+        });
+        int fd = ::open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            std::vector<struct iovec> iov = out.iovecs();
+            for (std::size_t i = 0; i < iov.size(); i += 512)
+                ::writev(fd, &iov[i], static_cast<int>(iov.size() - i < 512 ? iov.size() - i : 512));
+            ::close(fd);
+        }
+    }
+    std::remove(log_path);
+
+    {
+        Vita::MmapOutput out(log_path);
+        benchmark("format_to(MmapOutput)", ITERATIONS, [&out]() {
+            Vita::format_to(out, "{},{},{:.3f}\n", 12345, "name", 3.25);
+        });
+    }
+    std::remove(log_path);
+#endif
+
+    std::cout << "\n--- format_batch scaling (500k records) ---\n";
+
+    {
+        const Vita::CompiledFormat row("{},{},{:.6f}\n");
+        std::vector<std::tuple<int, std::string, double> > records;
+        for (int i = 0; i < 500000; ++i)
+            records.push_back(std::make_tuple(i, "name" + std::to_string(i % 1000), i * 0.001));
+        auto byte_sink = [](const char* data, std::size_t len) { sink = data[len - 1]; };
+
+        double serial = benchmark("format_to(CompiledFormat) loop", 3, [&records, &row]() {
+            Vita::detail::FormatOutput out;
+            for (std::size_t i = 0; i < records.size(); ++i) {
+                Vita::format_to(out, row, std::get<0>(records[i]), std::get<1>(records[i]),
+                                std::get<2>(records[i]));
+                if (out.size() > 60000) out.shrink(out.size());
+            }
+            sink = out.size() ? out.data()[0] : 0;
+        });
+        double naive = benchmark("format() loop", 3, [&records]() {
+            for (std::size_t i = 0; i < records.size(); ++i)
+                escape(Vita::format("{},{},{:.6f}\n", std::get<0>(records[i]), std::get<1>(records[i]),
+                                    std::get<2>(records[i])));
+        });
+        double planned = benchmark("format_records (one thread)", 3, [&records, &row]() {
+            Vita::detail::FormatOutput out;
+            Vita::format_records(out, row, records);
+            sink = out.size() ? out.data()[0] : 0;
+        });
+        std::cout << "  speedup over format() loop: " << naive / planned
+                  << "x, over format_to loop: " << serial / planned << "x\n";
+
+        unsigned cores = std::thread::hardware_concurrency();
+        for (unsigned threads = 1; threads <= (cores > 1 ? cores : 1); threads *= 2) {
+            std::string name = "format_batch, " + std::to_string(threads) + " thread(s)";
+            double ns = benchmark(name.c_str(), 3, [&records, &row, &byte_sink, threads]() {
+                Vita::format_batch(row, records, byte_sink, threads);
+            });
+            std::cout << "  speedup over loop: " << serial / ns << "x\n";
+        }
+    }
+
+    std::cout << "\n--- CsvWriter vs formatc loop (1M rows, GB/s of csv) ---\n";
+
+    {
+        const std::size_t rows = 1000000;
+        std::vector<std::int64_t> ids(rows);
+        std::vector<std::string> names(rows);
+        std::vector<double> scores(rows);
+        for (std::size_t i = 0; i < rows; ++i) {
+            ids[i] = static_cast<std::int64_t>(i) * 7919 - 1000000;
+            names[i] = i % 50 == 0 ? "with,comma" : "name" + std::to_string(i % 1000);
+            scores[i] = static_cast<double>(i) * 0.001;
+        }
+        std::size_t bytes = 0;
+        auto count_sink = [&bytes](const char* data, std::size_t len) {
+            bytes += len;
+            sink = data[len - 1];
+        };
+
+        double naive = benchmark("formatc(\"{},{},{:.6f}\\n\") loop", 3, [&]() {
+            bytes = 0;
+            for (std::size_t i = 0; i < rows; ++i) {
+                std::string line = Vita::formatc("{},{},{:.6f}\n", ids[i], names[i], scores[i]);
+                count_sink(line.data(), line.size());
+            }
+        });
+        std::cout << "  " << bytes / naive << " GB/s\n";
+
+        unsigned cores = std::thread::hardware_concurrency();
+        for (unsigned threads = 1; threads <= (cores > 1 ? cores : 1); threads *= 2) {
+            Vita::CsvOptions options;
+            options.header = false;
+            options.threads = threads;
+            Vita::CsvWriter csv(options);
+            csv.column("id", ids).column("name", names).column("score", scores, 6);
+            std::string name = "CsvWriter, " + std::to_string(threads) + " thread(s)";
+            double ns = benchmark(name.c_str(), 3, [&]() {
+                bytes = 0;
+                csv.write(count_sink);
+            });
+            std::cout << "  " << bytes / ns << " GB/s, speedup over loop: " << naive / ns << "x\n";
+        }
+    }
+
+    std::cout << "\n--- stack usage (VITA_FORMAT_SBO_SIZE = " << VITA_FORMAT_SBO_SIZE << ") ---\n";
+
+    std::cout << "sizeof(FormatOutput): " << sizeof(Vita::detail::FormatOutput) << "\n";
+    std::cout << "sizeof(InlineOutput<32>): " << sizeof(Vita::detail::InlineOutput<32>) << "\n";
+    std::cout << "sizeof(FormatArg): " << sizeof(Vita::detail::FormatArg) << "\n";
+    stack_usage("Vita::format(\"{} {}!\", ...)", []() {
+        escape(Vita::format("{} {}!", "Hello", 42));
+    });
+    stack_usage("Vita::format_inline<32>(\"{} {}!\", ...)", []() {
+        escape(Vita::format_inline<32>("{} {}!", "Hello", 42));
+    });
+    stack_usage("Vita::format(\"{:.3f}\", ...)", []() {
+        escape(Vita::format("{:.3f}", 3.14159));
+    });
+    stack_usage("Vita::format_inline<32>(\"{:.3f}\", ...)", []() {
+        escape(Vita::format_inline<32>("{:.3f}", 3.14159));
+    });
+
     std::cout << "\n======================\n";
     std::cout << "Benchmark complete.\n";
 
@@ -0,0 +1,78 @@
+// C++20 coroutine support of AsyncSink
+#include <gtest/gtest.h>
+#include <coroutine>
+#include <cstdio>
+#include <future>
+#include <string>
+
+#include "vita/async_sink.hpp"
+
+#include <unistd.h>
+
+namespace {
+
+// starts eagerly and runs to completion on whichever thread resumes it
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return Task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+std::string read_file(const std::string& path) {
+    std::string s;
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return s;
+    char buf[4096];
+    std::size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+    std::fclose(f);
+    return s;
+}
+
+std::string temp_path() {
+    char buf[] = "/tmp/vita_coro_XXXXXX";
+    int fd = ::mkstemp(buf);
+    if (fd >= 0) ::close(fd);
+    return buf;
+}
+
+// reports how many awaits resumed before their line was written
+Task write_lines(Vita::AsyncSink& sink, int count, std::promise<int>& done) {
+    std::uint64_t bytes = 0;
+    int early = 0;
+    for (int i = 0; i < count; ++i) {
+        bytes += Vita::format("line {}\n", i).size();
+        co_await sink.println("line {}", i);
+        if (sink.written() < bytes) ++early;
+    }
+    done.set_value(early);
+}
+
+} // namespace
+
+TEST(AsyncSinkCoroutine, AwaitResumesOnceWritten) {
+    for (int uring = 0; uring < 2; ++uring) {
+        std::string path = temp_path();
+        std::string expected;
+        for (int i = 0; i < 500; ++i) expected += Vita::format("line {}\n", i);
+        {
+            Vita::AsyncSinkOptions opts;
+            opts.flush_interval = std::chrono::milliseconds(60000);
+            opts.io_uring = uring != 0;
+            Vita::AsyncSink sink(path, opts);
+            std::promise<int> done;
+            std::future<int> early = done.get_future();
+            write_lines(sink, 500, done);
+            // awaiting submits the partial buffer, so this does not wait for the interval
+            ASSERT_EQ(early.wait_for(std::chrono::seconds(30)), std::future_status::ready);
+            EXPECT_EQ(early.get(), 0);
+            EXPECT_EQ(sink.written(), expected.size());
+            EXPECT_EQ(read_file(path), expected);
+        }
+        std::remove(path.c_str());
+    }
+}
@@ -357,6 +357,20 @@ TEST(EnsureFstring, ValidTypeSpec) {
     VALID("{:c}");
     VALID("{:p}");
 
+    VALID("{:?}");
+    VALID("{:\xe2\x98\x85>8}");
+    VALID("{:\xc2\xb7^6d}");
+    // bytes from 0xF8 up lead no sequence and fill as a single byte
+    VALID("{:\xf8>5}");
+    VALID("{:\xff<5d}");
+    VALID("{:j}");
+    VALID("{:h}");
+    VALID("{:q}");
+    VALID("{:u}");
+    VALID("{:>10.4u}");
+    VALID("{:>20?}");
+    VALID("{:.8j}");
+
     VALID("{0:d}");
     VALID("{1:x}");
     VALID("{2:f}");
@@ -577,7 +591,6 @@ TEST(EnsureFstring, InvalidBadTypeSpecifier) {
     INVALID("{:|}");
     INVALID("{:\\}");
     INVALID("{:/}");
-    INVALID("{:?}");
     INVALID("{:~}");
     INVALID("{:,}");
     INVALID("{:;}");
@@ -588,17 +601,13 @@ TEST(EnsureFstring, InvalidBadTypeSpecifier) {
     INVALID("{:\t}");
     INVALID("{:\n}");
 
-    INVALID("{:h}");
     INVALID("{:i}");
-    INVALID("{:j}");
     INVALID("{:k}");
     INVALID("{:l}");
     INVALID("{:m}");
     INVALID("{:n}");
-    INVALID("{:q}");
     INVALID("{:r}");
     INVALID("{:t}");
-    INVALID("{:u}");
     INVALID("{:v}");
     INVALID("{:w}");
     INVALID("{:y}");
@@ -730,6 +739,11 @@ TEST(EnsureFstring, InvalidMiscPatterns) {
     INVALID("{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{}{ ");
 }
 
+// the check agrees with the runtime parser on invalid lead bytes
+static_assert(Vita::detail::strsyn::validate("{:\xf8>5}", 6) == 0, "0xF8 fill");
+static_assert(Vita::detail::strsyn::validate("{:\xff^3}", 6) == 0, "0xFF fill");
+static_assert(Vita::detail::strsyn::validate("{:\xf0>5}", 6) != 0, "truncated 4-byte fill");
+
 TEST(EnsureFstring, ConstexprVariables) {
     constexpr const char* valid_str   = VITA_FORMAT_ENSURE_FSTRING("Hello, {}!");
     constexpr const char* invalid_str = VITA_FORMAT_ENSURE_FSTRING("{");
@@ -2,13 +2,22 @@
 // Comprehensive unit tests for Vita::format library
 // Uses Google Test framework
 
+// count heap use so the allocation statistics can be checked
+#define VITA_FORMAT_ALLOC_STATS 1
+
 #include <gtest/gtest.h>
+#include <climits>
 #include <cmath>
 #include <cstdint>
 #include <limits>
 #include <string>
+#include <thread>
 
 #include "vita/format.hpp"
+#include "vita/alloc_output.hpp"
+#include "vita/compiled_format.hpp"
+#include "vita/json.hpp"
+#include "vita/logfmt.hpp"
 
 // ============================================================================
 // Basic Format Tests
@@ -85,6 +94,293 @@ TEST(StringFormat, StringFill) {
     EXPECT_EQ(Vita::format("{:=^10}", "hi"), "====hi====");
 }
 
+// ============================================================================
+// UTF-8 Width Tests
+// ============================================================================
+
+TEST(Utf8Format, WidthCountsCodePoints) {
+    // "café" is 5 bytes, 4 code points
+    EXPECT_EQ(Vita::format("{:^7}", "caf\xc3\xa9"), " caf\xc3\xa9  ");
+    EXPECT_EQ(Vita::format("{:>6}", "caf\xc3\xa9"), "  caf\xc3\xa9");
+    EXPECT_EQ(Vita::format("{:4}", "caf\xc3\xa9"), "caf\xc3\xa9");
+    std::string s = "\xe6\x97\xa5\xe6\x9c\xac";  // two 3-byte code points
+    EXPECT_EQ(Vita::format("{:<4}|", s), s + "  |");
+}
+
+TEST(Utf8Format, PrecisionKeepsCodePointsWhole) {
+    EXPECT_EQ(Vita::format("{:.3}", "h\xc3\xa9llo"), "h\xc3\xa9l");
+    EXPECT_EQ(Vita::format("{:.1}", "\xc3\xa9t\xc3\xa9"), "\xc3\xa9");
+    std::string s = "\xe2\x82\xac" "100";  // euro sign
+    EXPECT_EQ(Vita::format("{:.2}", s), "\xe2\x82\xac" "1");
+    EXPECT_EQ(Vita::format("{:.4}", "abcdef"), "abcd");
+}
+
+TEST(Utf8Format, MultiByteFill) {
+    EXPECT_EQ(Vita::format("{:\xe2\x98\x85>5}", "ab"), "\xe2\x98\x85\xe2\x98\x85\xe2\x98\x85" "ab");
+    EXPECT_EQ(Vita::format("{:\xc2\xb7^6}", 42), "\xc2\xb7\xc2\xb7" "42" "\xc2\xb7\xc2\xb7");
+    EXPECT_EQ(Vita::format("{:\xe2\x94\x80<4}|", "x"), "x\xe2\x94\x80\xe2\x94\x80\xe2\x94\x80|");
+}
+
+TEST(Utf8Format, MultiByteFillSpec) {
+    Vita::detail::FormatSpec spec;
+    const char* s = "\xe2\x98\x85^10";
+    Vita::detail::parse_format_spec(s, s + std::strlen(s), spec);
+    EXPECT_EQ(spec.fill, '\xe2');
+    EXPECT_EQ(spec.fill_len, 3);
+    EXPECT_EQ(spec.fill_tail[0], '\x98');
+    EXPECT_EQ(spec.fill_tail[1], '\x85');
+    EXPECT_EQ(spec.align, '^');
+    EXPECT_EQ(spec.width, 10);
+}
+
+TEST(Utf8Format, EastAsianWidth) {
+    std::string s = "\xe6\x97\xa5\xe6\x9c\xac" "a";  // two wide ideographs + 'a'
+    EXPECT_EQ(Vita::detail::utf8_width(s.data(), s.size(), false), 3u);
+    EXPECT_EQ(Vita::detail::utf8_width(s.data(), s.size(), true), 5u);
+    EXPECT_EQ(Vita::detail::utf8_prefix(s.data(), s.size(), 3, true), 3u);
+    EXPECT_EQ(Vita::detail::utf8_prefix(s.data(), s.size(), 4, true), 6u);
+}
+
+TEST(Utf8Format, AsciiCheck) {
+    std::string s(100, 'a');
+    EXPECT_TRUE(Vita::detail::is_ascii(s.data(), s.size()));
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        std::string t = s;
+        t[i] = '\xc3';
+        EXPECT_FALSE(Vita::detail::is_ascii(t.data(), t.size())) << "position " << i;
+    }
+}
+
+TEST(Utf8Format, InvalidBytesCountAsOne) {
+    EXPECT_EQ(Vita::format("{:>4}", "\xff\xfe"), "  \xff\xfe");
+    EXPECT_EQ(Vita::format("{:.1}", "\xc3"), "\xc3");
+}
+
+TEST(Utf8Format, Validation) {
+    EXPECT_TRUE(Vita::detail::utf8_valid("", 0));
+    EXPECT_TRUE(Vita::detail::utf8_valid("caf\xc3\xa9", 5));
+    EXPECT_TRUE(Vita::detail::utf8_valid("\xf0\x9f\x98\x80", 4));
+    EXPECT_TRUE(Vita::detail::utf8_valid("\xef\xbf\xbd", 3));
+    EXPECT_FALSE(Vita::detail::utf8_valid("\xc0\xaf", 2));          // overlong
+    EXPECT_FALSE(Vita::detail::utf8_valid("\xed\xa0\x80", 3));      // surrogate
+    EXPECT_FALSE(Vita::detail::utf8_valid("\xf4\x90\x80\x80", 4));  // > U+10FFFF
+    EXPECT_FALSE(Vita::detail::utf8_valid("\xe2\x82", 2));          // truncated
+    EXPECT_FALSE(Vita::detail::utf8_valid("\x80", 1));
+
+    // errors and truncations at every offset across vector blocks
+    for (std::size_t i = 0; i < 40; ++i) {
+        std::string s(40, 'a');
+        EXPECT_TRUE(Vita::detail::utf8_valid(s.data(), s.size()));
+        s[i] = '\xff';
+        EXPECT_FALSE(Vita::detail::utf8_valid(s.data(), s.size())) << "position " << i;
+        std::string t(i, 'a');
+        t += "\xe2\x82";
+        EXPECT_FALSE(Vita::detail::utf8_valid(t.data(), t.size())) << "length " << i;
+        t += "\xac";
+        EXPECT_TRUE(Vita::detail::utf8_valid(t.data(), t.size())) << "length " << i;
+    }
+}
+
+TEST(Utf8Format, SanitizePresentation) {
+    const std::string fffd = "\xef\xbf\xbd";
+    EXPECT_EQ(Vita::format("{:u}", "ok \xc3\xa9"), "ok \xc3\xa9");
+    EXPECT_EQ(Vita::format("{:u}", "a\xff" "b"), "a" + fffd + "b");
+    // a truncated sequence is one maximal subpart
+    EXPECT_EQ(Vita::format("{:u}", "x\xe2\x82y"), "x" + fffd + "y");
+    EXPECT_EQ(Vita::format("{:u}", "\xc0\xaf"), fffd + fffd);
+    EXPECT_EQ(Vita::format("{:u}", std::string("end\xf0\x9f\x98")), "end" + fffd);
+    EXPECT_EQ(Vita::format("{:>4u}", "\xff"), "   " + fffd);
+    EXPECT_EQ(Vita::format("{}", "raw\xff"), "raw\xff");
+}
+
+// ============================================================================
+// Escaped String Tests
+// ============================================================================
+
+TEST(EscapedFormat, Debug) {
+    EXPECT_EQ(Vita::format("{:?}", "hello"), "\"hello\"");
+    EXPECT_EQ(Vita::format("{:?}", "a\"b\\c"), "\"a\\\"b\\\\c\"");
+    EXPECT_EQ(Vita::format("{:?}", "line\n\ttab"), "\"line\\n\\ttab\"");
+    EXPECT_EQ(Vita::format("{:?}", "\x01\x7f"), "\"\\x01\\x7f\"");
+    EXPECT_EQ(Vita::format("{:?}", ""), "\"\"");
+}
+
+TEST(EscapedFormat, DebugChar) {
+    EXPECT_EQ(Vita::format("{:?}", 'a'), "'a'");
+    EXPECT_EQ(Vita::format("{:?}", '\''), "'\\''");
+    EXPECT_EQ(Vita::format("{:?}", '\n'), "'\\n'");
+}
+
+TEST(EscapedFormat, Json) {
+    EXPECT_EQ(Vita::format("{:j}", "plain"), "plain");
+    EXPECT_EQ(Vita::format("{:j}", "say \"hi\"\n"), "say \\\"hi\\\"\\n");
+    EXPECT_EQ(Vita::format("{:j}", "\x1f"), "\\u001f");
+    EXPECT_EQ(Vita::format("{{\"msg\":\"{:j}\"}}", "a\\b"), "{\"msg\":\"a\\\\b\"}");
+    // non-ASCII bytes pass through untouched
+    EXPECT_EQ(Vita::format("{:j}", "caf\xc3\xa9"), "caf\xc3\xa9");
+}
+
+TEST(EscapedFormat, Html) {
+    EXPECT_EQ(Vita::format("{:h}", "<a href=\"x\">Tom & Jerry's</a>"),
+              "&lt;a href=&quot;x&quot;&gt;Tom &amp; Jerry&#39;s&lt;/a&gt;");
+    EXPECT_EQ(Vita::format("{:h}", "safe text"), "safe text");
+}
+
+TEST(EscapedFormat, Csv) {
+    EXPECT_EQ(Vita::format("{:q}", "plain"), "plain");
+    EXPECT_EQ(Vita::format("{:q}", "a,b"), "\"a,b\"");
+    EXPECT_EQ(Vita::format("{:q}", "say \"hi\""), "\"say \"\"hi\"\"\"");
+    EXPECT_EQ(Vita::format("{:q}", "two\nlines"), "\"two\nlines\"");
+}
+
+TEST(EscapedFormat, StdString) {
+    std::string s = "tab\there";
+    EXPECT_EQ(Vita::format("{:j}", s), "tab\\there");
+    EXPECT_EQ(Vita::formatc("{:?}", s), "\"tab\\there\"");
+}
+
+TEST(EscapedFormat, LongRuns) {
+    // clean runs longer than one vector, escapes at every lane position
+    std::string clean(100, 'x');
+    EXPECT_EQ(Vita::format("{:j}", clean), clean);
+    for (std::size_t i = 0; i < 70; ++i) {
+        std::string s(70, 'y');
+        s[i] = '"';
+        std::string expected = s.substr(0, i) + "\\\"" + s.substr(i + 1);
+        EXPECT_EQ(Vita::format("{:j}", s), expected) << "position " << i;
+    }
+}
+
+TEST(EscapedFormat, WidthAndPrecision) {
+    EXPECT_EQ(Vita::format("{:8?}", "ab"), "\"ab\"    ");
+    EXPECT_EQ(Vita::format("{:>8?}", "ab"), "    \"ab\"");
+    EXPECT_EQ(Vita::format("{:*^8?}", "ab"), "**\"ab\"**");
+    EXPECT_EQ(Vita::format("{:.2j}", "\"abc"), "\\\"a");
+    EXPECT_EQ(Vita::format("{:3h}", "<"), "&lt;");
+}
+
+// ============================================================================
+// JsonWriter Tests
+// ============================================================================
+
+TEST(JsonWriter, EmptyContainers) {
+    Vita::JsonWriter w;
+    w.begin_object().end_object();
+    EXPECT_EQ(w.finish(), "{}");
+    w.begin_array().end_array();
+    EXPECT_EQ(w.finish(), "[]");
+}
+
+TEST(JsonWriter, ObjectMembers) {
+    Vita::JsonWriter w;
+    w.begin_object()
+        .key("id").value(42)
+        .key("neg").value(-7LL)
+        .key("big").value(18446744073709551615ULL)
+        .key("ok").value(true)
+        .key("v").value(3.25)
+        .key("name").value("vita")
+        .key("none").null()
+     .end_object();
+    EXPECT_EQ(w.finish(),
+        "{\"id\":42,\"neg\":-7,\"big\":18446744073709551615,\"ok\":true,"
+        "\"v\":3.25,\"name\":\"vita\",\"none\":null}");
+}
+
+TEST(JsonWriter, Nesting) {
+    Vita::JsonWriter w;
+    w.begin_object()
+        .key("a").begin_array().value(1).value(2).begin_object().end_object().end_array()
+        .key("b").begin_object().key("c").begin_array().end_array().end_object()
+     .end_object();
+    EXPECT_EQ(w.finish(), "{\"a\":[1,2,{}],\"b\":{\"c\":[]}}");
+}
+
+TEST(JsonWriter, EscapesStringsAndKeys) {
+    Vita::JsonWriter w;
+    std::string msg = "line1\nline2 \"quoted\" \\ \x01";
+    w.begin_object().key("k\"ey").value(msg).end_object();
+    EXPECT_EQ(w.finish(),
+        "{\"k\\\"ey\":\"line1\\nline2 \\\"quoted\\\" \\\\ \\u0001\"}");
+}
+
+TEST(JsonWriter, NonFiniteAsNull) {
+    Vita::JsonWriter w;
+    w.begin_array()
+        .value(std::numeric_limits<double>::quiet_NaN())
+        .value(std::numeric_limits<double>::infinity())
+        .value(0.5f)
+     .end_array();
+    EXPECT_EQ(w.finish(), "[null,null,0.5]");
+}
+
+TEST(JsonWriter, MemberAndRaw) {
+    Vita::JsonWriter w;
+    w.begin_object().member("x", 1).member("s", std::string("y"))
+     .key("pre").raw_value("[1,2]", 5).end_object();
+    EXPECT_EQ(w.finish(), "{\"x\":1,\"s\":\"y\",\"pre\":[1,2]}");
+}
+
+TEST(JsonWriter, ExternalOutput) {
+    Vita::detail::FormatOutput out;
+    out.append("data: ", 6);
+    Vita::JsonWriter w(out);
+    w.begin_array().value('c').value(false).end_array();
+    EXPECT_EQ(out.finish(), "data: [\"c\",false]");
+}
+
+// ============================================================================
+// logfmt Tests
+// ============================================================================
+
+TEST(Logfmt, BarePairs) {
+    EXPECT_EQ(Vita::logfmt("level", "info", "status", 200, "ok", true, "latency_ms", 3.2),
+              "level=info status=200 ok=true latency_ms=3.2");
+}
+
+TEST(Logfmt, QuotesWhenNeeded) {
+    EXPECT_EQ(Vita::logfmt("msg", "request done"), "msg=\"request done\"");
+    EXPECT_EQ(Vita::logfmt("empty", ""), "empty=\"\"");
+    EXPECT_EQ(Vita::logfmt("eq", "a=b"), "eq=\"a=b\"");
+    EXPECT_EQ(Vita::logfmt("q", "say \"hi\"\n"), "q=\"say \\\"hi\\\"\\n\"");
+    EXPECT_EQ(Vita::logfmt("path", "/a/b\\c"), "path=/a/b\\c");
+    // once quoted, escapes apply before the byte that forced the quotes too
+    EXPECT_EQ(Vita::logfmt("path", "C:\\dir x\\y"), "path=\"C:\\\\dir x\\\\y\"");
+    EXPECT_EQ(Vita::logfmt("c", ' '), "c=\" \"");
+}
+
+TEST(Logfmt, AppendsToExistingOutput) {
+    Vita::detail::FormatOutput out;
+    out.append("ts=2025-01-01T00:00:00Z", 23);
+    std::string user = "bob smith";
+    Vita::kv(out, "user", user, "id", 7u);
+    EXPECT_EQ(out.finish(), "ts=2025-01-01T00:00:00Z user=\"bob smith\" id=7");
+}
+
+TEST(Logfmt, LongCleanValue) {
+    std::string v(100, 'x');
+    EXPECT_EQ(Vita::logfmt("v", v), "v=" + v);
+    v[77] = ' ';
+    EXPECT_EQ(Vita::logfmt("v", v), "v=\"" + v + "\"");
+}
+
+TEST(Logfmt, KeySet) {
+    static const Vita::KeySet<3> keys("level", "msg", "latency_ms");
+    EXPECT_EQ(keys.format("info", "hello world", 1.5),
+              "level=info msg=\"hello world\" latency_ms=1.5");
+
+    Vita::detail::FormatOutput out;
+    keys.write(out, "warn", "x", 2);
+    keys.write(out, "error", std::string("y z"), 3);
+    EXPECT_EQ(out.finish(),
+              "level=warn msg=x latency_ms=2 level=error msg=\"y z\" latency_ms=3");
+}
+
+TEST(Logfmt, KeySetLongKey) {
+    const Vita::KeySet<2> keys("a_really_long_key_name_that_overflows_the_slot", "b");
+    EXPECT_EQ(keys.format(1, 2), "a_really_long_key_name_that_overflows_the_slot=1 b=2");
+}
+
 // ============================================================================
 // Integer Format Tests
 // ============================================================================
@@ -430,6 +726,389 @@ TEST(Formatc, Escapes) {
     EXPECT_EQ(Vita::formatc("{{{}}}", "x"), "{x}");
 }
 
+// ============================================================================
+// format_to Tests
+// ============================================================================
+
+TEST(FormatTo, AppendsToOutput) {
+    Vita::detail::FormatOutput out;
+    Vita::format_to(out, "a={} ", 1);
+    Vita::format_to(out, std::string("b={:>3}"), "x");
+    Vita::format_to(out, "!");
+    EXPECT_EQ(out.finish(), "a=1 b=  x!");
+}
+
+// ============================================================================
+// format_append / format_assign Tests
+// ============================================================================
+
+TEST(FormatAppend, AppendsInPlace) {
+    std::string s = "GET ";
+    Vita::format_append(s, "/items/{}", 42);
+    Vita::format_append(s, std::string("?q={:>4}"), "x");
+    Vita::format_append(s, "");
+    EXPECT_EQ(s, "GET /items/42?q=   x");
+}
+
+TEST(FormatAppend, GrowsPastEstimate) {
+    std::string s = "head:";
+    std::string big(3000, 'b');
+    Vita::format_append(s, "{}|{}|{:*<100}", big, big, 1);
+    EXPECT_EQ(s.size(), 5u + 3000 + 1 + 3000 + 1 + 100);
+    EXPECT_EQ(s.substr(0, 6), "head:b");
+    EXPECT_EQ(s.substr(s.size() - 3), "***");
+}
+
+TEST(FormatAppend, AssignReusesCapacity) {
+    std::string s;
+    s.reserve(512);
+    const char* data = s.data();
+    for (int i = 0; i < 50; ++i) {
+        Vita::format_assign(s, "fragment {} of {}", i, 50);
+        EXPECT_EQ(s, "fragment " + std::to_string(i) + " of 50");
+    }
+    EXPECT_EQ(s.data(), data);
+    Vita::format_assign(s, std::string("{}"), 'z');
+    EXPECT_EQ(s, "z");
+}
+
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+TEST(FormatAppend, RestoresOnError) {
+    std::string s = "keep";
+    EXPECT_THROW(Vita::format_append(s, "{} {", 1), std::runtime_error);
+    EXPECT_EQ(s, "keep");
+}
+#endif
+
+// ============================================================================
+// Adaptive Reserve Tests
+// ============================================================================
+
+TEST(AdaptiveReserve, WarmCallSiteDoesNotRegrow) {
+    std::string body(1000, 'r');
+    for (int i = 0; i < 3; ++i) {
+        Vita::reset_alloc_stats();
+        std::string s = VITA_FORMAT("{}:{}", i, body);
+        EXPECT_EQ(s.size(), 1002u);
+        if (i > 0) {
+            EXPECT_EQ(Vita::alloc_stats().allocations, 1u);
+            EXPECT_EQ(Vita::alloc_stats().growths, 0u);
+        }
+    }
+}
+
+TEST(AdaptiveReserve, HintDecays) {
+    std::size_t capacity = 0;
+    for (int i = 0; i < 50; ++i) {
+        std::string text(i == 0 ? 2000 : 10, 'd');
+        std::string s = VITA_FORMAT("{}", text);
+        EXPECT_EQ(s, text);
+        capacity = s.capacity();
+    }
+    EXPECT_LT(capacity, 100u);
+}
+
+TEST(AdaptiveReserve, FormatcAcrossThreads) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 200; ++i) {
+                std::string pad(static_cast<std::size_t>(i % 7) * 40, 'p');
+                std::string s = Vita::formatc("adaptive {}:{}:{}", t, i, pad);
+                EXPECT_EQ(s, "adaptive " + std::to_string(t) + ":" + std::to_string(i) + ":" + pad);
+            }
+        });
+    }
+    for (std::size_t i = 0; i < threads.size(); ++i) threads[i].join();
+}
+
+// ============================================================================
+// CompiledFormat Tests
+// ============================================================================
+
+TEST(CompiledFormat, MatchesFormat) {
+    Vita::CompiledFormat row("{{{}}} {:>5}|{:.2f}|{:x} }}");
+    EXPECT_EQ(row.arg_count(), 4u);
+    EXPECT_EQ(Vita::format(row, 1, "ab", 3.14159, 255),
+              Vita::format("{{{}}} {:>5}|{:.2f}|{:x} }}", 1, "ab", 3.14159, 255));
+
+    Vita::detail::FormatOutput out;
+    Vita::format_to(out, row, 2, "c", 0.5, 16);
+    EXPECT_EQ(out.finish(), "{2}     c|0.50|10 }");
+}
+
+TEST(CompiledFormat, IndexedAndMissingArgs) {
+    Vita::CompiledFormat swap(std::string("{1}-{0}-{2}"));
+    EXPECT_EQ(swap.arg_count(), 3u);
+    EXPECT_EQ(Vita::format(swap, "a", "b", "c"), "b-a-c");
+    EXPECT_EQ(Vita::format(swap, "a", "b"), "b-a-{?}");
+}
+
+TEST(CompiledFormat, OutlivesSourceAndCopies) {
+    std::string source = "[{}]";
+    Vita::CompiledFormat fmt(source);
+    source = "changed";
+    Vita::CompiledFormat copy(fmt);
+    EXPECT_EQ(Vita::format(copy, std::string(500, 'q')), "[" + std::string(500, 'q') + "]");
+    EXPECT_EQ(Vita::format(fmt, 7), "[7]");
+}
+
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+TEST(CompiledFormat, InvalidFormatThrows) {
+    EXPECT_THROW(Vita::CompiledFormat("{abc}"), std::runtime_error);
+    EXPECT_THROW(Vita::CompiledFormat("{"), std::runtime_error);
+}
+#endif
+
+// ============================================================================
+// format_buffer Tests
+// ============================================================================
+
+TEST(FormatBuffer, Basic) {
+    Vita::Buffer b = Vita::format_buffer("{}-{:>4}", 7, "ab");
+    EXPECT_EQ(b.str(), "7-  ab");
+    EXPECT_EQ(std::strlen(b.c_str()), b.size());
+    EXPECT_EQ(Vita::format_buffer(std::string("{:x}"), 255).str(), "ff");
+
+    Vita::Buffer empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_STREQ(empty.c_str(), "");
+}
+
+TEST(FormatBuffer, AdoptsHeapBuffer) {
+    Vita::detail::FormatOutput out;
+    std::string big(5000, 'x');
+    Vita::format_to(out, "{}!", big);
+    const char* heap = out.data();
+
+    Vita::Buffer b(out);
+    EXPECT_EQ(b.data(), heap);
+    EXPECT_EQ(b.size(), 5001u);
+    EXPECT_EQ(b.c_str()[5001], '\0');
+    EXPECT_EQ(out.size(), 0u);
+
+    // the output falls back to its small buffer and stays usable
+    Vita::format_to(out, "{}", 1);
+    EXPECT_EQ(out.finish(), "1");
+}
+
+TEST(FormatBuffer, Move) {
+    Vita::Buffer a = Vita::format_buffer("{}", std::string(1000, 'm'));
+    const char* data = a.data();
+    Vita::Buffer b(std::move(a));
+    EXPECT_EQ(b.data(), data);
+    EXPECT_TRUE(a.empty());
+    a = std::move(b);
+    EXPECT_EQ(a.data(), data);
+    EXPECT_EQ(a.size(), 1000u);
+}
+
+#ifdef VITA_FORMAT_HAS_STRING_VIEW
+TEST(FormatBuffer, StringView) {
+    Vita::Buffer b = Vita::format_buffer("{}+{}", 1, 2);
+    EXPECT_EQ(std::string_view(b), "1+2");
+}
+#endif
+
+// ============================================================================
+// Allocator-aware output Tests
+// ============================================================================
+
+namespace {
+
+struct AllocCounts {
+    std::size_t allocations = 0;
+    std::size_t live = 0;
+};
+
+template <typename T>
+struct CountingAllocator {
+    typedef T value_type;
+    AllocCounts* counts;
+
+    explicit CountingAllocator(AllocCounts* c) : counts(c) {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) : counts(other.counts) {}
+
+    T* allocate(std::size_t n) {
+        ++counts->allocations;
+        counts->live += n * sizeof(T);
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, std::size_t n) {
+        counts->live -= n * sizeof(T);
+        ::operator delete(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& a, const CountingAllocator<U>& b) { return a.counts == b.counts; }
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>& a, const CountingAllocator<U>& b) { return a.counts != b.counts; }
+
+} // namespace
+
+TEST(AllocOutput, UsesAllocator) {
+    AllocCounts counts;
+    CountingAllocator<char> alloc(&counts);
+    std::string big(1000, 'x');
+    {
+        Vita::reset_alloc_stats();
+        Vita::BasicFormatOutput<CountingAllocator<char> > out(alloc);
+        Vita::format_to(out, "{}|{}", big, 42);
+        EXPECT_GE(counts.allocations, 1u);
+        auto s = out.finish();
+        EXPECT_EQ(std::string(s.data(), s.size()), big + "|42");
+        EXPECT_EQ(Vita::alloc_stats().allocations, 0u);
+    }
+    EXPECT_EQ(counts.live, 0u);
+
+    auto s = Vita::format(std::allocator_arg, alloc, "{}-{:>4}", 7, "ab");
+    EXPECT_EQ(std::string(s.data(), s.size()), "7-  ab");
+}
+
+#ifdef VITA_FORMAT_HAS_PMR
+TEST(AllocOutput, Pmr) {
+    char arena[4096];
+    std::pmr::monotonic_buffer_resource mr(arena, sizeof(arena), std::pmr::null_memory_resource());
+    std::pmr::string s = Vita::pmr::format(&mr, "{}:{}", std::string(300, 'p'), 1);
+    EXPECT_EQ(s.size(), 302u);
+    EXPECT_GE(s.data(), arena);
+    EXPECT_LT(s.data(), arena + sizeof(arena));
+    EXPECT_EQ(Vita::pmr::format(&mr, std::string("{:x}"), 255), "ff");
+}
+#endif
+
+TEST(AllocStats, CountsHeapUse) {
+    Vita::reset_alloc_stats();
+    std::string small = Vita::format("{}", 1);
+    EXPECT_EQ(Vita::alloc_stats().allocations, 0u);
+
+    // SBO -> heap growth, then the std::string result
+    std::string big = Vita::format("{}{}", std::string(200, 'a'), std::string(200, 'b'));
+    Vita::AllocStats stats = Vita::alloc_stats();
+    EXPECT_EQ(stats.allocations, 2u);
+    EXPECT_EQ(stats.growths, 1u);
+    EXPECT_GE(stats.bytes, 2 * big.size());
+
+    // counters are per thread
+    std::thread t([]() { EXPECT_EQ(Vita::alloc_stats().allocations, 0u); });
+    t.join();
+
+    Vita::reset_alloc_stats();
+    EXPECT_EQ(Vita::alloc_stats().bytes, 0u);
+}
+
+// ============================================================================
+// format_view Tests
+// ============================================================================
+
+TEST(FormatView, Basic) {
+    Vita::FormatView v = Vita::format_view("{}-{:>4}", 7, "ab");
+    EXPECT_EQ(std::string(v.data, v.size), "7-  ab");
+    EXPECT_EQ(std::strlen(v.c_str()), v.size);
+    EXPECT_EQ(Vita::format_view(std::string("{:x}"), 255).str(), "ff");
+    EXPECT_EQ(Vita::format_view("").size, 0u);
+}
+
+TEST(FormatView, ReusesBuffer) {
+    std::string big(5000, 'x');
+    Vita::FormatView first = Vita::format_view("{}", big);
+    EXPECT_EQ(first.size, 5000u);
+    const char* data = first.data;
+
+    // shorter results fit the capacity left by the first call
+    for (int i = 0; i < 100; ++i) {
+        Vita::FormatView v = Vita::format_view("{} {}", i, "short");
+        EXPECT_EQ(v.data, data);
+        EXPECT_EQ(v.str(), std::to_string(i) + " short");
+    }
+}
+
+TEST(FormatView, PerThread) {
+    Vita::FormatView main_view = Vita::format_view("main {}", 1);
+    std::string other;
+    std::thread t([&other]() { other = Vita::format_view("thread {}", 2).str(); });
+    t.join();
+    EXPECT_EQ(main_view.str(), "main 1");
+    EXPECT_EQ(other, "thread 2");
+}
+
+#ifdef VITA_FORMAT_HAS_STRING_VIEW
+TEST(FormatView, StringView) {
+    std::string_view sv = Vita::format_view("{}+{}", 1, 2);
+    EXPECT_EQ(sv, "1+2");
+    std::string_view part = std::string_view("abcdef").substr(1, 3);
+    EXPECT_EQ(Vita::format("[{:>5}]", part), "[  bcd]");
+}
+#endif
+
+// ============================================================================
+// format_fixed Tests
+// ============================================================================
+
+TEST(FormatFixed, Basic) {
+    static_assert(std::is_trivially_copyable<Vita::FixedString<64> >::value,
+                  "FixedString must be trivially copyable");
+    Vita::FixedString<64> s = Vita::format_fixed<64>("user:{}:{:>3}", 42, "x");
+    EXPECT_EQ(s.str(), "user:42:  x");
+    EXPECT_EQ(std::strlen(s.c_str()), s.size);
+    EXPECT_FALSE(s.truncated);
+    EXPECT_EQ(Vita::format_fixed<8>(std::string("{:x}"), 255).str(), "ff");
+    EXPECT_TRUE(Vita::format_fixed<8>("").empty());
+    EXPECT_EQ(Vita::FixedString<8>::capacity(), 8u);
+}
+
+TEST(FormatFixed, CopyAndCompare) {
+    Vita::FixedString<16> a = Vita::format_fixed<16>("k{}", 1);
+    Vita::FixedString<16> b;
+    std::memcpy(&b, &a, sizeof(a));
+    EXPECT_TRUE(a == b);
+    EXPECT_TRUE(a != Vita::format_fixed<16>("k{}", 2));
+    EXPECT_EQ(Vita::format("[{}]", a.data), "[k1]");
+}
+
+TEST(FormatFixed, Truncates) {
+    Vita::FixedString<8> s = Vita::format_fixed<8>("{}-{}", "abcdef", 123456);
+    EXPECT_TRUE(s.truncated);
+    EXPECT_EQ(s.str(), "abcdef-1");
+    EXPECT_EQ(s.data[8], '\0');
+
+    // fills and output far past the capacity are discarded
+    s = Vita::format_fixed<8>("{:*^40}{}", "mid", std::string(1000, 'z'));
+    EXPECT_TRUE(s.truncated);
+    EXPECT_EQ(s.str(), "********");
+
+    // exactly full is not truncated
+    s = Vita::format_fixed<8>("{}", "12345678");
+    EXPECT_FALSE(s.truncated);
+    EXPECT_EQ(s.size, 8u);
+}
+
+TEST(FormatFixed, TruncatesLargeCapacity) {
+    Vita::FixedString<1000> s = Vita::format_fixed<1000>("{}{}", std::string(600, 'a'), std::string(600, 'b'));
+    EXPECT_TRUE(s.truncated);
+    EXPECT_EQ(s.str(), std::string(600, 'a') + std::string(400, 'b'));
+}
+
+TEST(FormatFixed, TruncatesAtWholeSequence) {
+    // "\xC3\xA9" is two bytes; a cut through it drops the lead byte too
+    Vita::FixedString<4> s = Vita::format_fixed<4>("abc{}", "\xC3\xA9");
+    EXPECT_TRUE(s.truncated);
+    EXPECT_EQ(s.str(), "abc");
+
+    s = Vita::format_fixed<4>("ab{}", "\xC3\xA9z");
+    EXPECT_TRUE(s.truncated);
+    EXPECT_EQ(s.str(), "ab\xC3\xA9");
+}
+
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+TEST(FormatFixed, ThrowPolicy) {
+    EXPECT_EQ((Vita::format_fixed<8, Vita::FIXED_THROW>("{}", 1234)).str(), "1234");
+    EXPECT_THROW((Vita::format_fixed<4, Vita::FIXED_THROW>("{}", 123456)), std::runtime_error);
+}
+#endif
+
 // ============================================================================
 // VITA_FORMAT Macro Tests
 // ============================================================================
@@ -825,6 +1504,70 @@ TEST(CompileParse, ParseFormatString) {
     EXPECT_GE(parsed.num_segments, 2u); // At least literal and placeholder
 }
 
+#ifdef VITA_FORMAT_HAS_MAX_SIZE
+static_assert(Vita::max_formatted_size<int>("id={}") == 14, "literal plus int");
+static_assert(Vita::max_formatted_size<unsigned long long, bool>("{:x}{{}}{}") == 16 + 2 + 5, "hex, escapes, bool");
+static_assert(Vita::max_formatted_size<int>("{:*^40}") == 40, "width");
+static_assert(Vita::max_formatted_size<int>("{:\xC3\xA9>20}") == 40, "multi-byte fill");
+static_assert(Vita::max_formatted_size<>("{} {0}") == 7, "missing args");
+static_assert(Vita::max_formatted_size<const char*>("{}") == static_cast<std::size_t>(-1), "strings");
+static_assert(Vita::max_formatted_size<std::string>("{}") == static_cast<std::size_t>(-1), "strings");
+
+template <typename T>
+void expect_within_bound(const char* spec, T value, std::size_t bound) {
+    std::string s = Vita::format(spec, value);
+    EXPECT_LE(s.size(), bound) << spec << " -> " << s;
+}
+
+TEST(CompileParse, MaxFormattedSizeCoversExtremes) {
+    const long long ll[] = { LLONG_MIN, LLONG_MAX, -1, 0 };
+    for (long long v : ll) {
+        expect_within_bound("{}", v, Vita::max_formatted_size<long long>("{}"));
+        expect_within_bound("{:+}", v, Vita::max_formatted_size<long long>("{:+}"));
+        expect_within_bound("{:x}", v, Vita::max_formatted_size<long long>("{:x}"));
+        expect_within_bound("{:o}", v, Vita::max_formatted_size<long long>("{:o}"));
+        expect_within_bound("{:b}", v, Vita::max_formatted_size<long long>("{:b}"));
+    }
+    const int ints[] = { INT_MIN, INT_MAX };
+    for (int v : ints) {
+        expect_within_bound("{}", v, Vita::max_formatted_size<int>("{}"));
+        expect_within_bound("{:X}", v, Vita::max_formatted_size<int>("{:X}"));
+        expect_within_bound("{:08}", v, Vita::max_formatted_size<int>("{:08}"));
+    }
+    expect_within_bound("{:+}", ULLONG_MAX, Vita::max_formatted_size<unsigned long long>("{:+}"));
+    expect_within_bound("{:o}", UINT_MAX, Vita::max_formatted_size<unsigned>("{:o}"));
+    expect_within_bound("{:?}", '\x01', Vita::max_formatted_size<char>("{:?}"));
+    expect_within_bound("{}", reinterpret_cast<void*>(~static_cast<std::uintptr_t>(0)), Vita::max_formatted_size<void*>("{}"));
+
+    const double doubles[] = {
+        -std::numeric_limits<double>::max(), -std::numeric_limits<double>::min(),
+        -std::numeric_limits<double>::denorm_min(), -1.2345678901234567e20,
+        -1.2345678901234567e-5, -123456789012345.67
+    };
+    for (double v : doubles) {
+        expect_within_bound("{}", v, Vita::max_formatted_size<double>("{}"));
+        expect_within_bound("{:.17}", v, Vita::max_formatted_size<double>("{:.17}"));
+        expect_within_bound("{:f}", v, Vita::max_formatted_size<double>("{:f}"));
+        expect_within_bound("{:.30f}", v, Vita::max_formatted_size<double>("{:.30f}"));
+        expect_within_bound("{:.12E}", v, Vita::max_formatted_size<double>("{:.12E}"));
+    }
+}
+
+TEST(CompileParse, FormatSized) {
+    auto s = VITA_FORMAT_SIZED("{}:{:x}:{:.3f}", INT_MIN, ULLONG_MAX, -1.5);
+    static_assert(decltype(s)::capacity() == 11 + 1 + 16 + 1 + 37, "sized from the format");
+    EXPECT_EQ(s.str(), "-2147483648:ffffffffffffffff:-1.500");
+    EXPECT_FALSE(s.truncated);
+    EXPECT_EQ(VITA_FORMAT_SIZED("plain").str(), "plain");
+
+    // bytes from 0xF8 up are single-byte fills, as at run time
+    auto f = VITA_FORMAT_SIZED("{:\xff>9}", true);
+    EXPECT_EQ(f.str(), "\xff\xff\xff\xff\xfftrue");
+    EXPECT_FALSE(f.truncated);
+    expect_within_bound("{:\xf8<7d}", 42, Vita::max_formatted_size<int>("{:\xf8<7d}"));
+}
+#endif
+
 // ============================================================================
 // Stress Tests
 // ============================================================================
@@ -930,6 +1673,37 @@ TEST(FormatOutput, MoveHeapAllocated) {
     EXPECT_EQ(out2.finish(), large);
 }
 
+TEST(InlineOutput, CapacityIsTemplateParameter) {
+    Vita::detail::InlineOutput<16> out;
+    EXPECT_EQ(out.capacity(), 16u);
+    EXPECT_LT(sizeof(out), sizeof(Vita::detail::FormatOutput));
+
+    Vita::format_to(out, "{}-{}", std::string(20, 'a'), 7);
+    EXPECT_GE(out.capacity(), 22u);
+    EXPECT_EQ(out.finish(), std::string(20, 'a') + "-7");
+}
+
+TEST(InlineOutput, MoveAndRelease) {
+    Vita::detail::InlineOutput<8> small;
+    small.append("abc", 3);
+    Vita::detail::InlineOutput<8> moved(std::move(small));
+    EXPECT_EQ(small.size(), 0u);
+    EXPECT_EQ(moved.finish(), "abc");
+
+    Vita::detail::InlineOutput<8> big;
+    big.append("0123456789", 10);
+    Vita::Buffer b(big);
+    EXPECT_EQ(b.str(), "0123456789");
+    EXPECT_EQ(big.capacity(), 8u);
+}
+
+TEST(FormatInline, MatchesFormat) {
+    EXPECT_EQ(Vita::format_inline<8>("{} {}", "hello", 42), "hello 42");
+    EXPECT_EQ(Vita::format_inline<1024>(std::string("{:>600}"), 1), Vita::format("{:>600}", 1));
+    std::string long_text(300, 'z');
+    EXPECT_EQ(Vita::format_inline<32>("[{}]", long_text), "[" + long_text + "]");
+}
+
 // Alternate form tests (# flag)
 TEST(AlternateForm, HexPrefix) {
     // Note: Current library parses # but doesn't output 0x prefix
@@ -1027,9 +1801,13 @@ TEST(IntegerFormat, LongType) {
     EXPECT_EQ(Vita::format("{}", ul), "4000000000");
 }
 
-// Subnormal floating point - SKIPPED: library has infinite loop for denorm_min
-// The double_to_str_shortest function loops infinitely on subnormal numbers
-// TEST(FloatFormat, Subnormal) { ... }
+// Subnormal floating point
+TEST(FloatFormat, Subnormal) {
+    double denorm = std::numeric_limits<double>::denorm_min();
+    EXPECT_EQ(Vita::format("{}", denorm), "4.94065645841247e-324");
+    EXPECT_EQ(Vita::format("{:e}", denorm), "4.940656e-324");
+    EXPECT_EQ(Vita::format("{:.2f}", -denorm), "-0.00");
+}
 
 // Smallest normal number - use fixed format which handles it better
 TEST(FloatFormat, SmallestNormal) {
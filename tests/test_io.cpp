@@ -0,0 +1,1192 @@
+// test_io.cpp
+// Unit tests for the Vita::format output sinks (print, files, descriptors)
+// Uses Google Test framework
+
+// route output heap blocks through the pool so cross-thread reuse is tested
+#define VITA_FORMAT_POOL 1
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "vita/async_logger.hpp"
+#include "vita/batch.hpp"
+#include "vita/csv_writer.hpp"
+#include "vita/binlog.hpp"
+#include "vita/logfmt.hpp"
+#include "vita/print.hpp"
+#include "vita/segmented_output.hpp"
+#include "vita/stream_output.hpp"
+
+#if !defined(_WIN32)
+#include "vita/async_sink.hpp"
+#include "vita/file_writer.hpp"
+#include "vita/mmap_output.hpp"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::string read_stream(std::FILE* f) {
+    std::string s;
+    std::rewind(f);
+    char buf[4096];
+    std::size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+        s.append(buf, n);
+    return s;
+}
+
+#if !defined(_WIN32)
+std::string read_file(const std::string& path) {
+    std::string s;
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return s;
+    s = read_stream(f);
+    std::fclose(f);
+    return s;
+}
+
+// unique path under the system temp directory, removed on destruction
+struct TempPath {
+    std::string path;
+
+    explicit TempPath(const char* tag) {
+        char buf[256];
+        std::snprintf(buf, sizeof(buf), "/tmp/vita_%s_%ld_XXXXXX", tag, static_cast<long>(::getpid()));
+        int fd = ::mkstemp(buf);
+        if (fd >= 0) ::close(fd);
+        path = buf;
+    }
+
+    ~TempPath() { std::remove(path.c_str()); }
+};
+
+std::size_t count_lines(const std::string& data, const char* prefix) {
+    std::size_t count = 0, pos = 0, plen = std::strlen(prefix);
+    while (pos < data.size()) {
+        std::size_t nl = data.find('\n', pos);
+        if (nl == std::string::npos || data.compare(pos, plen, prefix) != 0) return 0;
+        ++count;
+        pos = nl + 1;
+    }
+    return count;
+}
+#endif
+
+// sink that collects everything and can be held closed to fill the ring
+struct CollectSink {
+    std::mutex mutex;
+    std::string data;
+    std::mutex gate;
+
+    Vita::AsyncLogger::Sink sink() {
+        return [this](const char* p, std::size_t n) {
+            std::lock_guard<std::mutex> hold(gate);
+            std::lock_guard<std::mutex> lock(mutex);
+            data.append(p, n);
+        };
+    }
+
+    std::string str() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return data;
+    }
+};
+
+// every line is "<thread> <seq>"; checks per-thread order and returns the line count
+std::size_t check_ordered_lines(const std::string& data, int threads) {
+    std::vector<int> next(static_cast<std::size_t>(threads), 0);
+    std::size_t count = 0;
+    int t, i;
+    for (std::size_t pos = 0; pos < data.size(); pos = data.find('\n', pos) + 1) {
+        if (std::sscanf(data.c_str() + pos, "%d %d", &t, &i) != 2) return 0;
+        if (i < next[static_cast<std::size_t>(t)]) return 0;
+        next[static_cast<std::size_t>(t)] = i + 1;
+        ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+// ============================================================================
+// AsyncLogger Tests
+// ============================================================================
+
+TEST(AsyncLogger, FormatsOnFlush) {
+    CollectSink out;
+    Vita::AsyncLogger log(out.sink());
+    {
+        std::string temp = "temporary";
+        char buf[16] = "buffer";
+        log.log("{} {} {:.2f}", temp, buf, 2.5);
+        temp.assign("overwritten");
+        std::strcpy(buf, "XXXXX");
+    }
+    log.log("{:>4}|{}|{}", 7, 'c', true);
+    log.log("[{}]", std::string());
+    log.flush();
+    EXPECT_EQ(out.str(), "temporary buffer 2.50\n   7|c|true\n[]\n");
+}
+
+TEST(AsyncLogger, CopiesViewedStrings) {
+    CollectSink out;
+    Vita::AsyncLogger log(out.sink());
+    std::string expected;
+    {
+        std::string owner(100, 'v');
+        log.log("{}|{}", Vita::detail::FormatArg(owner.data(), 40), owner.size());
+#ifdef VITA_FORMAT_HAS_STRING_VIEW
+        log.log("{}", std::string_view(owner).substr(50));
+        expected = std::string(40, 'v') + "|100\n" + std::string(50, 'v') + "\n";
+#else
+        expected = std::string(40, 'v') + "|100\n";
+#endif
+        owner.assign(100, 'X');
+    }
+    log.flush();
+    EXPECT_EQ(out.str(), expected);
+}
+
+TEST(AsyncLogger, LongStringsSpill) {
+    CollectSink out;
+    std::string a(500, 'a'), b(VITA_FORMAT_ASYNC_INLINE_TEXT, 'b');
+    {
+        Vita::AsyncLogger log(out.sink());
+        log.log("{}|{}|{}", a, b.c_str(), "x");
+        log.log("{}", b);
+    }
+    EXPECT_EQ(out.str(), a + "|" + b + "|x\n" + b + "\n");
+}
+
+TEST(AsyncLogger, DropWhenFull) {
+    CollectSink out;
+    Vita::AsyncLoggerOptions opts;
+    opts.capacity = 16;
+    opts.backpressure = Vita::ASYNC_DROP;
+    opts.batch_size = 1;
+    const int total = 1000;
+    int accepted = 0;
+    {
+        Vita::AsyncLogger log(out.sink(), opts);
+        {
+            std::lock_guard<std::mutex> hold(out.gate);
+            for (int i = 0; i < total; ++i)
+                accepted += log.log("0 {}", i) ? 1 : 0;
+        }
+        log.flush();
+        EXPECT_GT(log.dropped(), 0u);
+        EXPECT_EQ(log.dropped() + static_cast<std::size_t>(accepted), static_cast<std::size_t>(total));
+    }
+    EXPECT_EQ(check_ordered_lines(out.str(), 1), static_cast<std::size_t>(accepted));
+}
+
+TEST(AsyncLogger, GrowKeepsEverything) {
+    CollectSink out;
+    Vita::AsyncLoggerOptions opts;
+    opts.capacity = 16;
+    opts.backpressure = Vita::ASYNC_GROW;
+    opts.batch_size = 1;
+    const int total = 1000;
+    {
+        Vita::AsyncLogger log(out.sink(), opts);
+        {
+            std::lock_guard<std::mutex> hold(out.gate);
+            for (int i = 0; i < total; ++i)
+                EXPECT_TRUE(log.log("0 {} {}", i, std::string(static_cast<std::size_t>(i % 300), 'z')));
+        }
+        log.flush();
+        EXPECT_EQ(log.dropped(), 0u);
+    }
+    EXPECT_EQ(check_ordered_lines(out.str(), 1), static_cast<std::size_t>(total));
+}
+
+TEST(AsyncLogger, ConcurrentProducers) {
+    const int threads = 4, lines = 5000;
+    const Vita::AsyncBackpressure modes[] = { Vita::ASYNC_BLOCK, Vita::ASYNC_GROW };
+    for (Vita::AsyncBackpressure mode : modes) {
+        CollectSink out;
+        Vita::AsyncLoggerOptions opts;
+        opts.capacity = 64;
+        opts.backpressure = mode;
+        {
+            Vita::AsyncLogger log(out.sink(), opts);
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&log, t]() {
+                    for (int i = 0; i < lines; ++i) {
+                        log.log("{} {} payload={}", t, i, "text");
+                        if (i % 1000 == 0) log.flush();
+                    }
+                });
+            }
+            for (auto& w : workers) w.join();
+        }
+        EXPECT_EQ(check_ordered_lines(out.str(), threads), static_cast<std::size_t>(threads * lines))
+            << "mode " << mode;
+    }
+}
+
+// ============================================================================
+// Binary Log Tests
+// ============================================================================
+
+namespace {
+
+std::vector<std::string> decode_all(const std::string& data, bool* error = 0) {
+    std::vector<std::string> lines;
+    Vita::BinlogReader reader(data.data(), data.size());
+    Vita::detail::FormatOutput out;
+    std::uint64_t ts;
+    while (reader.next(out, ts)) {
+        lines.push_back(std::string(out.data(), out.size()));
+        out.shrink(out.size());
+    }
+    if (error) *error = reader.error();
+    return lines;
+}
+
+} // namespace
+
+TEST(Binlog, RoundTrip) {
+    std::FILE* f = std::tmpfile();
+    ASSERT_NE(f, nullptr);
+    std::string name = "widget";
+    const char* missing = nullptr;
+    int x = 0;
+    {
+        Vita::BinlogWriter log(f);
+        for (int i = 0; i < 3; ++i)
+            VITA_BINLOG(log, "item {} of {:>3}: {}", i, 3, name);
+        VITA_BINLOG(log, "{} {} {} {:x} {:b}", true, 'c', -42, 255u, 5ULL);
+        VITA_BINLOG(log, "{:.3f} {} {:e}", 3.14159, -2.5f, 1234.5L);
+        VITA_BINLOG(log, "{}|{}|{:?}", "literal", missing, std::string("tab\t"));
+        VITA_BINLOG(log, "{} {}", LLONG_MIN, ULLONG_MAX);
+        VITA_BINLOG(log, "{}", static_cast<const void*>(&x));
+        VITA_BINLOG(log, "no args");
+    }
+    std::vector<std::string> lines = decode_all(read_stream(f));
+    std::fclose(f);
+
+    ASSERT_EQ(lines.size(), 9u);
+    EXPECT_EQ(lines[0], "item 0 of   3: widget");
+    EXPECT_EQ(lines[2], "item 2 of   3: widget");
+    EXPECT_EQ(lines[3], Vita::format("{} {} {} {:x} {:b}", true, 'c', -42, 255u, 5ULL));
+    EXPECT_EQ(lines[4], Vita::format("{:.3f} {} {:e}", 3.14159, -2.5f, 1234.5L));
+    EXPECT_EQ(lines[5], "literal|(null)|\"tab\\t\"");
+    EXPECT_EQ(lines[6], Vita::format("{} {}", LLONG_MIN, ULLONG_MAX));
+    EXPECT_EQ(lines[7], Vita::format("{}", static_cast<const void*>(&x)));
+    EXPECT_EQ(lines[8], "no args");
+}
+
+TEST(Binlog, TimestampsAndDefinitions) {
+    std::FILE* f = std::tmpfile();
+    ASSERT_NE(f, nullptr);
+    std::uint64_t before = Vita::detail::binlog_now();
+    {
+        Vita::BinlogWriter log(f);
+        for (int i = 0; i < 100; ++i)
+            VITA_BINLOG(log, "processed tick {} of the current batch", i);
+    }
+    std::uint64_t after = Vita::detail::binlog_now();
+    std::string data = read_stream(f);
+    std::fclose(f);
+
+    // the format string is stored once, not per event
+    std::size_t n = 0;
+    for (std::size_t pos = data.find("tick {}"); pos != std::string::npos; pos = data.find("tick {}", pos + 1))
+        ++n;
+    EXPECT_EQ(n, 1u);
+    EXPECT_LT(data.size(), Vita::format("processed tick {} of the current batch\n", 99).size() * 100 / 3);
+
+    Vita::BinlogReader reader(data.data(), data.size());
+    Vita::detail::FormatOutput out;
+    std::uint64_t ts, prev = before;
+    int count = 0;
+    while (reader.next(out, ts)) {
+        EXPECT_GE(ts, prev);
+        EXPECT_LE(ts, after);
+        prev = ts;
+        ++count;
+    }
+    EXPECT_EQ(count, 100);
+    EXPECT_FALSE(reader.error());
+}
+
+TEST(Binlog, MalformedInput) {
+    bool error = false;
+    EXPECT_TRUE(decode_all("not a binlog", &error).empty());
+    EXPECT_TRUE(error);
+
+    std::FILE* f = std::tmpfile();
+    ASSERT_NE(f, nullptr);
+    {
+        Vita::BinlogWriter log(f);
+        VITA_BINLOG(log, "a {}", 1);
+        VITA_BINLOG(log, "b {}", std::string(100, 'x'));
+    }
+    std::string data = read_stream(f);
+    std::fclose(f);
+
+    std::vector<std::string> lines = decode_all(data.substr(0, data.size() - 10), &error);
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(lines[0], "a 1");
+    EXPECT_TRUE(error);
+}
+
+TEST(Binlog, WriteErrorsSetFailed) {
+    std::FILE* f = std::fopen("/dev/full", "wb");
+    if (!f) return;   // not every system has /dev/full
+    {
+        Vita::BinlogWriter log(f, 16);
+        EXPECT_FALSE(log.failed());
+        for (int i = 0; i < 100; ++i) VITA_BINLOG(log, "record {}", i);
+        log.flush();
+        EXPECT_TRUE(log.failed());
+    }
+    std::fclose(f);
+}
+
+// the argument tags are part of the file format
+TEST(Binlog, FixedArgumentTags) {
+    std::FILE* f = std::tmpfile();
+    ASSERT_NE(f, nullptr);
+    {
+        Vita::BinlogWriter log(f);
+        VITA_BINLOG(log, "{} {}", 5, std::string_view("ab"));
+    }
+    std::string data = read_stream(f);
+    std::fclose(f);
+
+    // int 5 zigzag encoded, then the view as a string
+    const char tail[] = { 2, 3, 10, 10, 2, 'a', 'b' };
+    ASSERT_GE(data.size(), sizeof(tail));
+    EXPECT_EQ(data.substr(data.size() - sizeof(tail)), std::string(tail, sizeof(tail)));
+    EXPECT_EQ(decode_all(data), std::vector<std::string>{"5 ab"});
+}
+
+// ============================================================================
+// StreamOutput Tests
+// ============================================================================
+
+namespace {
+
+struct ChunkSink {
+    std::string data;
+    std::size_t calls = 0;
+    std::size_t largest = 0;
+
+    Vita::StreamOutput::Sink sink() {
+        return [this](const char* p, std::size_t n) {
+            data.append(p, n);
+            ++calls;
+            if (n > largest) largest = n;
+        };
+    }
+};
+
+} // namespace
+
+TEST(StreamOutput, MatchesFormat) {
+    ChunkSink out;
+    std::string blob(10000, 'b');
+    {
+        Vita::StreamOutput stream(out.sink(), 64);
+        Vita::format_to(stream, "{}:{}|{:.3f}|{:>8}\n", "key", blob, 2.5, 42);
+        EXPECT_EQ(stream.total(), blob.size() + 20);
+        EXPECT_LE(out.largest, 64u);
+    }
+    EXPECT_EQ(out.data, Vita::format("{}:{}|{:.3f}|{:>8}\n", "key", blob, 2.5, 42));
+    EXPECT_GT(out.calls, blob.size() / 64);
+}
+
+TEST(StreamOutput, PaddingLargerThanWindow) {
+    ChunkSink out;
+    Vita::StreamOutput stream(out.sink(), 16);
+    Vita::format_to(stream, "[{:>100}][{:*^75}][{:\u2500<40}]", "r", "c", "u");
+    Vita::format_to(stream, "[{:<30?}][{:>30j}]", "tab\there", "quote\"d");
+    stream.flush();
+    EXPECT_LE(out.largest, 16u);
+    EXPECT_EQ(out.data, Vita::format("[{:>100}][{:*^75}][{:\u2500<40}]", "r", "c", "u") +
+                        Vita::format("[{:<30?}][{:>30j}]", "tab\there", "quote\"d"));
+}
+
+TEST(StreamOutput, ContiguousRequestsLargerThanWindow) {
+    ChunkSink out;
+    {
+        Vita::StreamOutput stream(out.sink(), 8);
+        Vita::kv(stream, "level", "info", "message", "hello world", "n", 3);
+    }
+    EXPECT_EQ(out.data, Vita::logfmt("level", "info", "message", "hello world", "n", 3));
+}
+
+TEST(StreamOutput, SeparatorAfterHandOff) {
+    ChunkSink out;
+    {
+        Vita::StreamOutput stream(out.sink(), 8);
+        Vita::format_to(stream, "{}", "12345678");
+        stream.flush();
+        Vita::kv(stream, "a", 1);
+    }
+    EXPECT_EQ(out.data, "12345678 a=1");
+}
+
+TEST(StreamOutput, LargeOutputBoundedWindow) {
+    std::size_t total = 0, largest = 0;
+    std::string blob(1 << 20, 'z');
+    Vita::StreamOutput stream([&](const char*, std::size_t n) {
+        total += n;
+        if (n > largest) largest = n;
+    });
+    for (int i = 0; i < 32; ++i)
+        Vita::format_to(stream, "{}\n", blob);
+    stream.flush();
+    EXPECT_EQ(total, 32u * ((1u << 20) + 1));
+    EXPECT_LE(largest, static_cast<std::size_t>(VITA_FORMAT_SBO_SIZE));
+    EXPECT_EQ(stream.capacity(), static_cast<std::size_t>(VITA_FORMAT_SBO_SIZE));
+}
+
+// ============================================================================
+// SegmentedOutput Tests
+// ============================================================================
+
+TEST(SegmentedOutput, MatchesFormat) {
+    Vita::SegmentedOutput out(64);
+    std::string blob(10000, 'b');
+    Vita::format_to(out, "{}:{}|{:.3f}|{:>80}\n", "key", blob, 2.5, 42);
+    Vita::kv(out, "level", "info", "n", 3);
+    std::string expected = Vita::format("{}:{}|{:.3f}|{:>80}\n", "key", blob, 2.5, 42) + " " +
+                           Vita::logfmt("level", "info", "n", 3);
+    EXPECT_EQ(out.total(), expected.size());
+    EXPECT_EQ(out.flatten(), expected);
+    EXPECT_GT(out.segment_count(), blob.size() / 64);
+
+    std::string joined;
+    out.for_each_segment([&joined](const char* p, std::size_t n) {
+        EXPECT_LE(n, 64u);
+        joined.append(p, n);
+    });
+    EXPECT_EQ(joined, expected);
+}
+
+TEST(SegmentedOutput, ChunksNeverMove) {
+    Vita::SegmentedOutput out(256);
+    Vita::format_to(out, "{}", std::string(200, 'a'));
+    const char* first = out.data();
+    for (int i = 0; i < 1000; ++i)
+        Vita::format_to(out, "line {}\n", i);
+    const char* seen = 0;
+    out.for_each_segment([&seen](const char* p, std::size_t) {
+        if (!seen) seen = p;
+    });
+    EXPECT_EQ(seen, first);
+}
+
+TEST(SegmentedOutput, ClearReusesChunks) {
+    Vita::SegmentedOutput out(128);
+    for (int i = 0; i < 100; ++i)
+        Vita::format_to(out, "{:>20}\n", i);
+    std::vector<const char*> chunks;
+    out.for_each_segment([&chunks](const char* p, std::size_t) { chunks.push_back(p); });
+
+    out.clear();
+    EXPECT_EQ(out.total(), 0u);
+    EXPECT_EQ(out.segment_count(), 0u);
+    EXPECT_EQ(out.flatten(), "");
+
+    for (int i = 0; i < 100; ++i)
+        Vita::format_to(out, "{:>20}\n", i);
+    out.for_each_segment([&chunks](const char* p, std::size_t) {
+        EXPECT_NE(std::find(chunks.begin(), chunks.end(), p), chunks.end());
+    });
+}
+
+#if !defined(_WIN32)
+TEST(SegmentedOutput, Writev) {
+    TempPath path("vita_segmented");
+    Vita::SegmentedOutput out(100);
+    for (int i = 0; i < 500; ++i)
+        Vita::format_to(out, "{},{},{:.2f}\n", i, "name", i * 0.5);
+    std::vector<struct iovec> iov = out.iovecs();
+    EXPECT_EQ(iov.size(), out.segment_count());
+
+    int fd = ::open(path.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    std::size_t written = 0;
+    for (std::size_t i = 0; i < iov.size(); i += 64) {
+        int n = static_cast<int>(iov.size() - i < 64 ? iov.size() - i : 64);
+        ssize_t r = ::writev(fd, &iov[i], n);
+        ASSERT_GT(r, 0);
+        written += static_cast<std::size_t>(r);
+    }
+    ::close(fd);
+    EXPECT_EQ(written, out.total());
+    EXPECT_EQ(read_file(path.path), out.flatten());
+}
+#endif
+
+// ============================================================================
+// format_batch Tests
+// ============================================================================
+
+TEST(FormatBatch, MatchesSerialOutput) {
+    Vita::CompiledFormat row("{},{},{:.3f}\n");
+    std::vector<std::tuple<int, std::string, double> > records;
+    std::string expected;
+    for (int i = 0; i < 5000; ++i) {
+        records.push_back(std::make_tuple(i, "name" + std::to_string(i % 13), i * 0.25));
+        expected += Vita::format("{},{},{:.3f}\n", i, "name" + std::to_string(i % 13), i * 0.25);
+    }
+
+    for (unsigned threads = 1; threads <= 8; threads *= 2) {
+        Vita::BatchOptions options;
+        options.threads = threads;
+        options.chunk_records = 37;
+        options.max_pending = 1;
+        std::string got;
+        std::size_t calls = 0;
+        Vita::format_batch(row, records, [&got, &calls](const char* data, std::size_t len) {
+            got.append(data, len);
+            ++calls;
+        }, options);
+        EXPECT_EQ(got, expected) << threads << " threads";
+        EXPECT_EQ(calls, (records.size() + 36) / 37);
+    }
+}
+
+TEST(FormatBatch, SingleValuesAndPairs) {
+    std::vector<int> values;
+    for (int i = 0; i < 100; ++i) values.push_back(i);
+    std::string got;
+    Vita::format_batch(Vita::CompiledFormat("{:02x} "), values,
+                       [&got](const char* data, std::size_t len) { got.append(data, len); }, 3);
+    EXPECT_EQ(got.substr(0, 12), "00 01 02 03 ");
+    EXPECT_EQ(got.size(), 300u);
+
+    std::vector<std::pair<std::string, int> > pairs;
+    pairs.push_back(std::make_pair(std::string("a"), 1));
+    pairs.push_back(std::make_pair(std::string("b"), 2));
+    got.clear();
+    Vita::format_batch(Vita::CompiledFormat("{}={};"), pairs,
+                       [&got](const char* data, std::size_t len) { got.append(data, len); });
+    EXPECT_EQ(got, "a=1;b=2;");
+
+    std::vector<int> none;
+    Vita::format_batch(Vita::CompiledFormat("{}"), none,
+                       [](const char*, std::size_t) { FAIL() << "sink called"; });
+}
+
+TEST(FormatBatch, SinkErrorStopsWorkers) {
+    std::vector<int> values(100000, 7);
+    Vita::BatchOptions options;
+    options.threads = 4;
+    options.chunk_records = 100;
+    std::size_t calls = 0;
+    EXPECT_THROW(Vita::format_batch(Vita::CompiledFormat("{}\n"), values,
+                                    [&calls](const char*, std::size_t) {
+                                        if (++calls == 3) throw std::runtime_error("disk full");
+                                    }, options),
+                 std::runtime_error);
+    EXPECT_EQ(calls, 3u);
+}
+
+TEST(FormatRecords, MatchesFormatForEverySpecKind) {
+    Vita::CompiledFormat row("{0}|{1}|{2}|{2:.2f}|{3:>6}|{4:x}|{5}|{6}|{1:?}|{7}|{9}\n");
+    std::vector<std::tuple<int, std::string, double, long long, unsigned, bool, char, const char*> > records;
+    std::string expected;
+    for (int i = 0; i < 200; ++i) {
+        records.push_back(std::make_tuple(-i, i % 3 ? "s" + std::to_string(i) : "q\"t", i / 7.0,
+                                          static_cast<long long>(i) << 40, static_cast<unsigned>(i) * 977,
+                                          i % 2 == 0, static_cast<char>('a' + i % 26),
+                                          i % 4 ? "cs" : static_cast<const char*>(nullptr)));
+        const auto& r = records.back();
+        expected += Vita::format("{0}|{1}|{2}|{2:.2f}|{3:>6}|{4:x}|{5}|{6}|{1:?}|{7}|{9}\n",
+                                 std::get<0>(r), std::get<1>(r), std::get<2>(r), std::get<3>(r),
+                                 std::get<4>(r), std::get<5>(r), std::get<6>(r), std::get<7>(r));
+    }
+
+    Vita::detail::FormatOutput out;
+    Vita::format_records(out, row, records);
+    EXPECT_EQ(std::string(out.data(), out.size()), expected);
+}
+
+TEST(FormatRecords, StructOfArraysAndSingleValues) {
+    std::vector<int> ids;
+    std::vector<std::string> names;
+    std::vector<float> scores;
+    std::string expected;
+    for (int i = 0; i < 100; ++i) {
+        ids.push_back(i * 13);
+        names.push_back("n" + std::to_string(i));
+        scores.push_back(i * 0.5f);
+        expected += Vita::format("{},{},{:.1f}\n", ids.back(), names.back(), scores.back());
+    }
+
+    Vita::CompiledFormat row("{},{},{:.1f}\n");
+    Vita::detail::FormatOutput out;
+    Vita::format_columns(out, row, ids.size(), ids.data(), names.data(), scores.data());
+    EXPECT_EQ(std::string(out.data(), out.size()), expected);
+
+    Vita::detail::FormatOutput single;
+    Vita::format_records(single, Vita::CompiledFormat("[{}]"), ids);
+    EXPECT_EQ(std::string(single.data(), 9), "[0][13][2");
+
+    Vita::detail::FormatOutput none;
+    Vita::format_records(none, row, std::vector<int>());
+    EXPECT_EQ(none.size(), 0u);
+}
+
+// ============================================================================
+// CsvWriter Tests
+// ============================================================================
+
+TEST(CsvWriter, MatchesRowByRowFormat) {
+    std::vector<std::int64_t> ids;
+    std::vector<unsigned short> small;
+    std::vector<std::string> names;
+    std::vector<double> scores;
+    std::vector<float> ratios;
+    std::string expected = "id,small,name,score,ratio\n";
+    for (int i = 0; i < 3000; ++i) {
+        ids.push_back((i % 7 == 0 ? -1 : 1) * static_cast<std::int64_t>(i) * 1000003);
+        small.push_back(static_cast<unsigned short>(i * 31));
+        names.push_back(i % 5 == 0 ? "a,b" : i % 11 == 0 ? "say \"hi\"" : "n" + std::to_string(i));
+        scores.push_back(i * 0.125 - 17.3);
+        ratios.push_back(static_cast<float>(i) / 3);
+        std::string name = names.back();
+        if (i % 5 == 0) name = "\"a,b\"";
+        else if (i % 11 == 0) name = "\"say \"\"hi\"\"\"";
+        expected += Vita::format("{},{},{},{:.3f},{}\n", ids.back(), small.back(), name,
+                                 scores.back(), ratios.back());
+    }
+
+    for (unsigned threads = 1; threads <= 4; threads *= 2) {
+        Vita::CsvOptions options;
+        options.threads = threads;
+        options.tile_rows = 97;
+        Vita::CsvWriter csv(options);
+        csv.column("id", ids)
+           .column("small", small)
+           .column("name", names)
+           .column("score", scores, 3)
+           .column("ratio", ratios);
+        EXPECT_EQ(csv.rows(), 3000u);
+        EXPECT_EQ(csv.columns(), 5u);
+        EXPECT_EQ(csv.str(), expected) << threads << " threads";
+    }
+}
+
+TEST(CsvWriter, HeaderAndCStrings) {
+    const char* words[] = { "plain", nullptr, "line\nbreak" };
+    int counts[] = { 1, 2, 3 };
+    Vita::CsvOptions options;
+    options.header = false;
+    Vita::CsvWriter csv(options);
+    csv.column("word", words, 3).column("count", counts, 3);
+    EXPECT_EQ(csv.str(), "plain,1\n,2\n\"line\nbreak\",3\n");
+
+    Vita::CsvWriter named;
+    named.column("a,b", counts, 3);
+    EXPECT_EQ(named.str(), "\"a,b\"\n1\n2\n3\n");
+
+    Vita::CsvWriter empty;
+    EXPECT_EQ(empty.str(), "");
+}
+
+TEST(CsvWriter, TabSeparated) {
+    std::vector<std::string> text = { "a,b", "a long field, with commas\tand a tab", "q\"" };
+    std::vector<double> x = { 1.5, -2, 0.25 };
+    Vita::CsvOptions options;
+    options.delimiter = '\t';
+    options.tile_rows = 2;
+    Vita::CsvWriter csv(options);
+    csv.column("text", text).column("x\ty", x, 2);
+    EXPECT_EQ(csv.str(), "text\t\"x\ty\"\n"
+                         "a,b\t1.50\n"
+                         "\"a long field, with commas\tand a tab\"\t-2.00\n"
+                         "\"q\"\"\"\t0.25\n");
+}
+
+TEST(CsvWriter, RowCountMismatchThrows) {
+    std::vector<int> a(3), b(4);
+    Vita::CsvWriter csv;
+    csv.column("a", a);
+    EXPECT_THROW(csv.column("b", b), std::runtime_error);
+}
+
+TEST(CsvWriter, PrecisionAbove17Throws) {
+    std::vector<double> x(3);
+    Vita::CsvWriter csv;
+    csv.column("ok", x, 17);
+    EXPECT_THROW(csv.column("x", x, 18), std::runtime_error);
+}
+
+// ============================================================================
+// Buffer Pool Tests
+// ============================================================================
+
+TEST(BufferPool, ReusesBlocks) {
+    Vita::trim_pool();
+    std::string text(1000, 'x');
+    const char* first;
+    {
+        Vita::Buffer b = Vita::format_buffer("{}", text);
+        first = b.data();
+    }
+    Vita::PoolStats before = Vita::pool_stats();
+    EXPECT_EQ(before.cached, 1024u);
+
+    Vita::Buffer b = Vita::format_buffer("{}", text);
+    EXPECT_EQ(b.data(), first);
+    EXPECT_EQ(b.str(), text);
+    EXPECT_EQ(Vita::pool_stats().hits, before.hits + 1);
+    EXPECT_EQ(Vita::pool_stats().cached, 0u);
+}
+
+TEST(BufferPool, FreedOnOtherThreadReturns) {
+    Vita::trim_pool();
+    const std::size_t count = 2 * VITA_FORMAT_POOL_CACHE;
+    std::vector<Vita::Buffer> buffers;
+    for (std::size_t i = 0; i < count; ++i)
+        buffers.push_back(Vita::format_buffer("{:>1000}", i));
+
+    // the consumer keeps VITA_FORMAT_POOL_CACHE blocks, shares the rest and
+    // hands its cache over when it exits
+    std::thread consumer([&buffers]() {
+        std::vector<Vita::Buffer> mine(std::move(buffers));
+        mine.clear();
+        EXPECT_EQ(Vita::pool_stats().shared, (count - VITA_FORMAT_POOL_CACHE) * 1024);
+    });
+    consumer.join();
+    Vita::PoolStats stats = Vita::pool_stats();
+    EXPECT_EQ(stats.shared, count * 1024);
+    EXPECT_GE(stats.shared_high, count * 1024);
+
+    std::size_t hits = stats.hits;
+    for (std::size_t i = 0; i < count; ++i)
+        EXPECT_EQ(Vita::format_buffer("{:>1000}", i).size(), 1000u);
+    EXPECT_EQ(Vita::pool_stats().hits, hits + count);
+
+    // a refill takes at most VITA_FORMAT_POOL_CACHE blocks
+    EXPECT_EQ(Vita::pool_stats().shared, (count - VITA_FORMAT_POOL_CACHE) * 1024);
+    EXPECT_EQ(Vita::pool_stats().cached, VITA_FORMAT_POOL_CACHE * 1024u);
+}
+
+TEST(BufferPool, Trim) {
+    {
+        Vita::Buffer a = Vita::format_buffer("{:>600}", 1);
+        Vita::Buffer b = Vita::format_buffer("{:>3000}", 2);
+    }
+    EXPECT_GT(Vita::pool_stats().cached, 0u);
+    EXPECT_GE(Vita::pool_stats().cached_high, Vita::pool_stats().cached);
+    Vita::trim_pool();
+    EXPECT_EQ(Vita::pool_stats().cached, 0u);
+    EXPECT_EQ(Vita::pool_stats().shared, 0u);
+}
+
+TEST(BufferPool, LargeBlocksBypassPool) {
+    Vita::trim_pool();
+    std::string big(VITA_FORMAT_POOL_MAX_BLOCK + 1, 'x');
+    { Vita::Buffer b = Vita::format_buffer("{}", big); }
+    EXPECT_EQ(Vita::pool_stats().cached, 0u);
+}
+
+// ============================================================================
+// print / println Tests
+// ============================================================================
+
+TEST(Print, ToFile) {
+    std::FILE* f = std::tmpfile();
+    ASSERT_NE(f, nullptr);
+    Vita::print(f, "{} + {} = {}", 1, 2, 3);
+    Vita::println(f, " [{:>5}]", "ok");
+    Vita::println(f, "done");
+    EXPECT_EQ(read_stream(f), "1 + 2 = 3 [   ok]\ndone\n");
+    std::fclose(f);
+}
+
+TEST(Print, LargeMessage) {
+    std::FILE* f = std::tmpfile();
+    ASSERT_NE(f, nullptr);
+    std::string big(VITA_FORMAT_SBO_SIZE * 4, 'x');
+    Vita::println(f, "{}|{}", big, 7);
+    EXPECT_EQ(read_stream(f), big + "|7\n");
+    std::fclose(f);
+}
+
+#if !defined(_WIN32)
+TEST(Print, ToDescriptor) {
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    Vita::print(fds[1], "fd {}", 42);
+    Vita::println(fds[1], " {:x}", 255);
+    ::close(fds[1]);
+
+    char buf[64];
+    ssize_t n = ::read(fds[0], buf, sizeof(buf));
+    ::close(fds[0]);
+    ASSERT_GT(n, 0);
+    EXPECT_EQ(std::string(buf, static_cast<std::size_t>(n)), "fd 42 ff\n");
+}
+
+TEST(Print, ConcurrentLinesStayWhole) {
+    TempPath tmp("print");
+    int fd = ::open(tmp.path.c_str(), O_WRONLY | O_TRUNC | O_APPEND);
+    ASSERT_GE(fd, 0);
+
+    const int threads = 4, lines = 500;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([fd, t]() {
+            for (int i = 0; i < lines; ++i)
+                Vita::println(fd, "thread={} line={} payload={:->40}", t, i, "end");
+        });
+    }
+    for (auto& w : workers) w.join();
+    ::close(fd);
+
+    std::string data = read_file(tmp.path);
+    std::size_t count = 0, pos = 0;
+    while (pos < data.size()) {
+        std::size_t nl = data.find('\n', pos);
+        ASSERT_NE(nl, std::string::npos);
+        std::string line = data.substr(pos, nl - pos);
+        EXPECT_EQ(line.compare(0, 7, "thread="), 0) << line;
+        EXPECT_EQ(line.substr(line.size() - 3), "end") << line;
+        ++count;
+        pos = nl + 1;
+    }
+    EXPECT_EQ(count, static_cast<std::size_t>(threads * lines));
+}
+
+// ============================================================================
+// FileWriter Tests
+// ============================================================================
+
+TEST(FileWriter, WritesOnClose) {
+    TempPath tmp("writer");
+    {
+        Vita::FileWriter log(tmp.path);
+        log.write("{} + {} = {}", 1, 2, 3);
+        log.writeln(" [{:>5}]", "ok");
+        log.append("raw\n", 4);
+    }
+    EXPECT_EQ(read_file(tmp.path), "1 + 2 = 3 [   ok]\nraw\n");
+}
+
+TEST(FileWriter, FlushMakesDataVisible) {
+    TempPath tmp("writer");
+    Vita::FileWriterOptions opts;
+    opts.flush_interval = std::chrono::milliseconds(60000);
+    Vita::FileWriter log(tmp.path, opts);
+    log.writeln("first {}", 1);
+    log.flush();
+    EXPECT_EQ(read_file(tmp.path), "first 1\n");
+    log.writeln("second {}", 2);
+    log.flush();
+    EXPECT_EQ(read_file(tmp.path), "first 1\nsecond 2\n");
+    EXPECT_FALSE(log.failed());
+}
+
+TEST(FileWriter, IntervalFlush) {
+    TempPath tmp("writer");
+    Vita::FileWriterOptions opts;
+    opts.flush_interval = std::chrono::milliseconds(5);
+    Vita::FileWriter log(tmp.path, opts);
+    log.writeln("tick");
+    for (int i = 0; i < 200 && read_file(tmp.path).empty(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(read_file(tmp.path), "tick\n");
+}
+
+TEST(FileWriter, MessagesLargerThanBuffer) {
+    TempPath tmp("writer");
+    Vita::FileWriterOptions opts;
+    opts.buffer_size = 4096;
+    std::string big(10000, 'x');
+    {
+        Vita::FileWriter log(tmp.path, opts);
+        log.writeln("a");
+        log.writeln("{}", big);
+        log.writeln("b");
+    }
+    EXPECT_EQ(read_file(tmp.path), "a\n" + big + "\nb\n");
+}
+
+TEST(FileWriter, Preallocate) {
+    TempPath tmp("writer");
+    Vita::FileWriterOptions opts;
+    opts.preallocate = 1 << 20;
+    {
+        Vita::FileWriter log(tmp.path, opts);
+        for (int i = 0; i < 100; ++i)
+            log.writeln("line {}", i);
+        log.flush();
+        struct stat st;
+        ASSERT_EQ(::stat(tmp.path.c_str(), &st), 0);
+        EXPECT_EQ(static_cast<std::size_t>(st.st_size), read_file(tmp.path).size());
+    }
+    EXPECT_EQ(count_lines(read_file(tmp.path), "line "), 100u);
+}
+
+TEST(FileWriter, Rotation) {
+    TempPath tmp("writer");
+    Vita::FileWriterOptions opts;
+    opts.buffer_size = 4096;
+    opts.rotate_size = 8192;
+    opts.max_files = 20;
+    const int lines = 1000;
+    unsigned rotations;
+    {
+        Vita::FileWriter log(tmp.path, opts);
+        for (int i = 0; i < lines; ++i)
+            log.writeln("line={} payload={:->60}", i, "end");
+        log.flush();
+        rotations = log.rotations();
+    }
+    ASSERT_GT(rotations, 0u);
+    ASSERT_LE(rotations, opts.max_files);
+
+    std::size_t total = count_lines(read_file(tmp.path), "line=");
+    EXPECT_LE(read_file(tmp.path).size(), opts.rotate_size);
+    for (unsigned i = 1; i <= rotations; ++i) {
+        std::string rotated = tmp.path + "." + std::to_string(i);
+        std::string data = read_file(rotated);
+        EXPECT_LE(data.size(), opts.rotate_size);
+        total += count_lines(data, "line=");
+        std::remove(rotated.c_str());
+    }
+    EXPECT_EQ(total, static_cast<std::size_t>(lines));
+}
+
+TEST(FileWriter, ConcurrentWriters) {
+    TempPath tmp("writer");
+    Vita::FileWriterOptions opts;
+    opts.buffer_size = 8192;
+    opts.max_pending = 2;
+    const int threads = 4, lines = 2000;
+    {
+        Vita::FileWriter log(tmp.path, opts);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&log, t]() {
+                for (int i = 0; i < lines; ++i)
+                    log.writeln("thread={} line={} payload={:->40}", t, i, "end");
+            });
+        }
+        for (auto& w : workers) w.join();
+    }
+    EXPECT_EQ(count_lines(read_file(tmp.path), "thread="), static_cast<std::size_t>(threads * lines));
+}
+
+// ============================================================================
+// MmapOutput Tests
+// ============================================================================
+
+TEST(MmapOutput, TruncatesOnClose) {
+    TempPath tmp("mmap");
+    {
+        Vita::MmapOutput out(tmp.path);
+        Vita::format_to(out, "{} + {} = {}\n", 1, 2, 3);
+        EXPECT_EQ(out.close(), 10u);
+        EXPECT_FALSE(out.is_open());
+        EXPECT_EQ(out.close(), 10u);
+    }
+    EXPECT_EQ(read_file(tmp.path), "1 + 2 = 3\n");
+}
+
+TEST(MmapOutput, GrowsAcrossChunks) {
+    TempPath tmp("mmap");
+    std::string expected;
+    {
+        Vita::MmapOutput out(tmp.path, 4096);
+        for (int i = 0; i < 5000; ++i) {
+            Vita::format_to(out, "row={:05} value={:.2f}\n", i, i * 0.5);
+            expected += Vita::format("row={:05} value={:.2f}\n", i, i * 0.5);
+        }
+        EXPECT_GT(out.capacity(), 4096u);
+        EXPECT_EQ(std::string(out.data(), out.size()), expected);
+    }
+    EXPECT_EQ(read_file(tmp.path), expected);
+}
+
+TEST(MmapOutput, NonTemporalCopies) {
+    TempPath tmp("mmap");
+    std::string big;
+    for (int i = 0; i < 10000; ++i)
+        big += static_cast<char>('a' + i % 26);
+    std::string expected;
+    {
+        Vita::MmapOutput out(tmp.path, 4096, true);
+        EXPECT_TRUE(out.bounded());
+        for (int i = 0; i < 20; ++i) {
+            Vita::format_to(out, "{}:{}|", i, big.substr(static_cast<std::size_t>(i)));
+            expected += Vita::format("{}:{}|", i, big.substr(static_cast<std::size_t>(i)));
+        }
+        // larger than the window in one contiguous piece
+        std::memset(out.grow(100000), 'z', 100000);
+        expected.append(100000, 'z');
+        EXPECT_EQ(out.close(), expected.size());
+        EXPECT_THROW(Vita::format_to(out, "{}", 1), std::runtime_error);
+    }
+    EXPECT_EQ(read_file(tmp.path), expected);
+}
+
+TEST(MmapOutput, WritesAfterCloseThrow) {
+    TempPath tmp("mmap");
+    Vita::MmapOutput out(tmp.path);
+    out.close();
+    EXPECT_THROW(Vita::format_to(out, "{}", 1), std::runtime_error);
+}
+
+// ============================================================================
+// AsyncSink Tests
+// ============================================================================
+
+namespace {
+
+// whether this process may set up an io_uring at all
+bool io_uring_available() {
+#if VITA_FORMAT_HAS_IO_URING
+    Vita::detail::IoRing ring;
+    return ring.open(4);
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+TEST(AsyncSink, WritesInOrderOnEachBackend) {
+    for (int uring = 0; uring < 2; ++uring) {
+        TempPath tmp("async");
+        Vita::AsyncSinkOptions opts;
+        opts.buffer_size = 4096;
+        opts.buffers = 3;
+        opts.io_uring = uring != 0;
+        std::string expected;
+        {
+            Vita::AsyncSink sink(tmp.path, opts);
+            if (uring && io_uring_available()) {
+                EXPECT_EQ(sink.backend(), Vita::BACKEND_IO_URING);
+            } else {
+                EXPECT_EQ(sink.backend(), Vita::BACKEND_THREAD);
+            }
+            for (int i = 0; i < 20000; ++i) {
+                std::string pad(static_cast<std::size_t>(i % 300), '.');
+                sink.println("line {} {}", i, pad);
+                expected += Vita::format("line {} {}\n", i, pad);
+            }
+        }
+        EXPECT_EQ(read_file(tmp.path), expected) << (uring ? "io_uring" : "thread");
+    }
+}
+
+TEST(AsyncSink, TicketWaitSubmitsPartialBuffer) {
+    TempPath tmp("async");
+    Vita::AsyncSinkOptions opts;
+    opts.flush_interval = std::chrono::milliseconds(60000);
+    Vita::AsyncSink sink(tmp.path, opts);
+    Vita::AsyncSink::Ticket t = sink.println("first {}", 1);
+    t.wait();
+    EXPECT_TRUE(t.done());
+    EXPECT_EQ(read_file(tmp.path), "first 1\n");
+    sink.print("second ");
+    sink.append("2\n", 2);
+    sink.flush();
+    EXPECT_EQ(read_file(tmp.path), "first 1\nsecond 2\n");
+    EXPECT_EQ(sink.written(), 17u);
+    EXPECT_FALSE(sink.failed());
+}
+
+#if VITA_FORMAT_HAS_IO_URING && defined(VITA_FORMAT_TESTING)
+// a ring that breaks with writes in flight hands them over to pwrite
+TEST(AsyncSink, RingFailureFallsBackToPwrite) {
+    TempPath tmp("async");
+    Vita::AsyncSinkOptions opts;
+    opts.buffer_size = 4096;
+    opts.buffers = 3;
+    std::string expected;
+    {
+        Vita::AsyncSink sink(tmp.path, opts);
+        for (int i = 0; i < 2000; ++i) {
+            sink.println("before {}", i);
+            expected += Vita::format("before {}\n", i);
+        }
+        sink.flush();
+        Vita::detail::io_ring_fault().store(EIO);
+        for (int i = 0; i < 5000; ++i) {
+            sink.println("after {}", i);
+            expected += Vita::format("after {}\n", i);
+        }
+        sink.flush();
+        Vita::detail::io_ring_fault().store(0);
+        EXPECT_FALSE(sink.failed());
+        EXPECT_EQ(sink.backend(), Vita::BACKEND_THREAD);
+    }
+    EXPECT_EQ(read_file(tmp.path), expected);
+}
+#endif
+
+// the awaited bytes wait in the overflow buffer until a slot frees up
+TEST(AsyncSink, TicketWaitSubmitsOverflowBytes) {
+    TempPath tmp("async");
+    Vita::AsyncSinkOptions opts;
+    opts.buffer_size = 4096;
+    opts.buffers = 1;
+    opts.flush_interval = std::chrono::milliseconds(2000);
+    Vita::AsyncSink sink(tmp.path, opts);
+    std::string data(5000, 'x');
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    sink.append(data.data(), data.size()).wait();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+    EXPECT_EQ(read_file(tmp.path), data);
+}
+
+TEST(AsyncSink, AppendsToExistingFile) {
+    TempPath tmp("async");
+    { Vita::AsyncSink sink(tmp.path); sink.println("one"); }
+    { Vita::AsyncSink sink(tmp.path); sink.println("two"); }
+    EXPECT_EQ(read_file(tmp.path), "one\ntwo\n");
+}
+
+TEST(AsyncSink, ConcurrentWritersKeepLinesWhole) {
+    TempPath tmp("async");
+    Vita::AsyncSinkOptions opts;
+    opts.buffer_size = 4096;
+    opts.buffers = 2;
+    {
+        Vita::AsyncSink sink(tmp.path, opts);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+            threads.push_back(std::thread([&sink, t]() {
+                for (int i = 0; i < 5000; ++i) sink.println("writer{} {}", t, i);
+            }));
+        for (std::size_t t = 0; t < threads.size(); ++t) threads[t].join();
+    }
+    std::string data = read_file(tmp.path);
+    std::vector<int> next(4, 0);
+    for (std::size_t pos = 0; pos < data.size();) {
+        std::size_t nl = data.find('\n', pos);
+        ASSERT_NE(nl, std::string::npos);
+        int t = data[pos + 6] - '0';
+        ASSERT_TRUE(t >= 0 && t < 4);
+        EXPECT_EQ(data.substr(pos, nl - pos), Vita::format("writer{} {}", t, next[t]++));
+        pos = nl + 1;
+    }
+    EXPECT_EQ(next, std::vector<int>(4, 5000));
+}
+
+#endif
@@ -0,0 +1,26 @@
+// string formatting under VITA_FORMAT_UTF8_POLICY SANITIZE
+#define VITA_FORMAT_UTF8_POLICY SANITIZE
+#include "vita/format.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+
+namespace {
+const std::string fffd = "\xef\xbf\xbd";
+}
+
+TEST(Utf8Sanitize, PlainStrings) {
+    EXPECT_EQ(Vita::format("{}", "raw\xff"), "raw" + fffd);
+    EXPECT_EQ(Vita::format("{:>5}", "\xff"), "    " + fffd);
+    EXPECT_EQ(Vita::format("{:u}", std::string("a\xc0\xaf")), "a" + fffd + fffd);
+}
+
+// cleaning must not drop the escaping of the presentation
+TEST(Utf8Sanitize, EscapePresentationsKeepEscaping) {
+    const char* bad = "a\"b\xff<c>";
+    EXPECT_EQ(Vita::format("{{\"k\":\"{:j}\"}}", bad), "{\"k\":\"a\\\"b" + fffd + "<c>\"}");
+    EXPECT_EQ(Vita::format("{:?}", bad), "\"a\\\"b" + fffd + "<c>\"");
+    EXPECT_EQ(Vita::format("{:h}", bad), "a&quot;b" + fffd + "&lt;c&gt;");
+    EXPECT_EQ(Vita::format("{:q}", std::string("x,\xff")), "\"x," + fffd + "\"");
+    EXPECT_EQ(Vita::format("{:>8j}", "\"\xff"), "     \\\"" + fffd);
+}
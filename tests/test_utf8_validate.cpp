@@ -0,0 +1,89 @@
+// the SSSE3 utf-8 validator against the scalar one; built with -mssse3
+#include "vita/format.hpp"
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if !VITA_FORMAT_SSSE3
+#error "test_utf8_validate.cpp must be built with SSSE3 enabled"
+#endif
+
+namespace {
+
+std::string hex(const std::string& s) {
+    std::string out;
+    for (char c : s) out += Vita::format("{:02x} ", static_cast<unsigned char>(c));
+    return out;
+}
+
+bool scalar_valid(const std::string& s) {
+    return Vita::detail::utf8_valid_prefix(s.data(), s.size()) == s.size();
+}
+
+void expect_agree(const std::string& s) {
+    EXPECT_EQ(Vita::detail::utf8_valid(s.data(), s.size()), scalar_valid(s))
+        << hex(s);
+}
+
+// well-formed and ill-formed sequences, each tried at every position
+// around the 16 byte block edges
+const char* const samples[] = {
+    "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xF4\x8F\xBF\xBF", "\xED\x9F\xBF",
+    "\xC3", "\xE2\x82", "\xF0\x9F\x98", "\xE2", "\xF0",                   // truncated
+    "\xC0\xAF", "\xC1\xBF", "\xE0\x80\xAF", "\xE0\x9F\xBF", "\xF0\x80\x80\xAF",
+    "\xF0\x8F\xBF\xBF",                                                   // overlong
+    "\xED\xA0\x80", "\xED\xBF\xBF",                                       // surrogates
+    "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xF8\x88\x80\x80\x80", "\xFF", // too large
+    "\x80", "\xBF", "\xC3\xA9\x80", "\xE2\x82\xAC\x80",                   // stray continuation
+};
+
+} // namespace
+
+TEST(Utf8Validate, AgreesAcrossBlockEdges) {
+    for (const char* sample : samples) {
+        for (std::size_t total = 1; total <= 50; ++total) {
+            std::string seq(sample);
+            if (seq.size() > total) continue;
+            for (std::size_t at = 0; at + seq.size() <= total; ++at) {
+                std::string s(total, 'a');
+                s.replace(at, seq.size(), seq);
+                expect_agree(s);
+            }
+        }
+    }
+}
+
+TEST(Utf8Validate, AgreesWithNonAsciiPadding) {
+    // multi-byte neighbours keep both blocks on the vector path
+    for (const char* sample : samples) {
+        std::string seq(sample);
+        for (std::size_t at = 0; at < 40; ++at) {
+            std::string s;
+            while (s.size() < at) s += "\xC3\xA9";
+            s.resize(at, 'a');
+            s += seq;
+            while (s.size() < 48) s += "\xE2\x82\xAC";
+            expect_agree(s);
+            expect_agree(s.substr(0, 32));
+            expect_agree(s.substr(0, 33));
+        }
+    }
+}
+
+TEST(Utf8Validate, AgreesOnRandomInput) {
+    const char alphabet[] = {'a', '\x80', '\xBF', '\xC2', '\xDF', '\xE0', '\xED', '\xEF',
+                             '\xF0', '\xF4', '\xF5', '\xA0', '\x90', '\x8F', '\x9F'};
+    std::uint32_t state = 12345;
+    for (int n = 0; n < 20000; ++n) {
+        state = state * 1664525u + 1013904223u;
+        std::size_t len = (state >> 8) % 40;
+        std::string s;
+        for (std::size_t i = 0; i < len; ++i) {
+            state = state * 1664525u + 1013904223u;
+            s += alphabet[(state >> 16) % sizeof(alphabet)];
+        }
+        expect_agree(s);
+    }
+}
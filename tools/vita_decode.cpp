@@ -0,0 +1,71 @@
+// vita_decode - render a VITA_BINLOG stream as text
+//
+// usage: vita_decode [file]    (reads stdin without a file argument)
+//
+// Each event is printed as "<seconds>.<nanoseconds> <message>".
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "vita/binlog.hpp"
+#include "vita/print.hpp"
+
+static bool read_all(std::FILE* f, std::string& data) {
+    char buf[65536];
+    std::size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+        data.append(buf, n);
+    return !std::ferror(f);
+}
+
+int main(int argc, char** argv) {
+    std::FILE* in = stdin;
+    if (argc > 1) {
+        in = std::fopen(argv[1], "rb");
+        if (!in) {
+            Vita::println(stderr, "vita_decode: cannot open {}", argv[1]);
+            return 1;
+        }
+    }
+
+    std::string data;
+    bool ok = read_all(in, data);
+    if (in != stdin) std::fclose(in);
+    if (!ok) {
+        Vita::println(stderr, "vita_decode: read error");
+        return 1;
+    }
+
+    Vita::BinlogReader reader(data.data(), data.size());
+    Vita::detail::FormatOutput out;
+    Vita::detail::FormatOutput message;
+    std::uint64_t ts;
+    bool malformed = false;
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+    try {
+#endif
+        while (reader.next(message, ts)) {
+            Vita::format_to(out, "{}.{:09} ", ts / 1000000000u, ts % 1000000000u);
+            out.append(message.data(), message.size());
+            out.append('\n');
+            message.shrink(message.size());
+            if (out.size() >= 64 * 1024) {
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                out.shrink(out.size());
+            }
+        }
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+    } catch (const std::runtime_error&) {
+        // a format string or argument in the stream that does not format
+        malformed = true;
+    }
+#endif
+    std::fwrite(out.data(), 1, out.size(), stdout);
+
+    if (malformed || reader.error()) {
+        Vita::println(stderr, "vita_decode: malformed stream");
+        return 1;
+    }
+    return 0;
+}
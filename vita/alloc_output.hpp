@@ -0,0 +1,138 @@
+// vita/alloc_output.hpp - outputs and results that use a caller's allocator
+//
+// Usage:
+//   Arena arena;
+//   ArenaAllocator<char> alloc(arena);
+//   auto s = Vita::format(std::allocator_arg, alloc, "{} {}", a, b);
+//
+//   std::pmr::monotonic_buffer_resource mr(buf, sizeof(buf));
+//   std::pmr::string p = Vita::pmr::format(&mr, "{} {}", a, b);
+//
+// BasicFormatOutput<Alloc> is a FormatOutput that starts in its small
+// buffer and grows through Alloc instead of new[]; finish() returns a
+// string using the same allocator, so neither the buffer nor the result
+// touches the global heap. Vita::alloc_stats does not count these
+// allocations.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_ALLOC_OUTPUT_HPP
+#define VITA_ALLOC_OUTPUT_HPP
+
+#include <memory>
+
+#include "format.hpp"
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <memory_resource>
+#define VITA_FORMAT_HAS_PMR 1
+#endif
+
+namespace Vita {
+
+template <typename Alloc>
+class BasicFormatOutput : public detail::FormatOutput {
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<char> CharAlloc;
+    typedef std::allocator_traits<CharAlloc> Traits;
+
+public:
+    typedef std::basic_string<char, std::char_traits<char>, CharAlloc> string_type;
+
+    explicit BasicFormatOutput(const Alloc& alloc = Alloc())
+        : detail::FormatOutput(0, 0, &BasicFormatOutput::grow_block), alloc_(alloc), block_(0), block_size_(0)
+    {
+        set_buffer(inline_buffer(), VITA_FORMAT_SBO_SIZE);
+    }
+
+    ~BasicFormatOutput() { free_block(); }
+
+    BasicFormatOutput(const BasicFormatOutput&) = delete;
+    BasicFormatOutput& operator=(const BasicFormatOutput&) = delete;
+
+    // the output as a string from the same allocator; leaves the output empty
+    string_type finish() {
+        string_type result(data(), size(), alloc_);
+        shrink(size());
+        return result;
+    }
+
+    CharAlloc get_allocator() const { return alloc_; }
+
+private:
+    static void grow_block(detail::OutputBase& out, std::size_t need) {
+        BasicFormatOutput& self = static_cast<BasicFormatOutput&>(out);
+        std::size_t cap = self.capacity() + self.capacity() / 2;
+        if (cap < need) cap = need;
+
+        char* block = Traits::allocate(self.alloc_, cap);
+        std::memcpy(block, self.data(), self.size());
+        self.free_block();
+        self.block_ = block;
+        self.block_size_ = cap;
+        self.set_buffer(block, cap);
+    }
+
+    void free_block() {
+        if (block_) Traits::deallocate(alloc_, block_, block_size_);
+        block_ = 0;
+    }
+
+    CharAlloc alloc_;
+    char* block_;
+    std::size_t block_size_;
+};
+
+namespace detail {
+
+template <typename Alloc>
+inline typename BasicFormatOutput<Alloc>::string_type
+format_alloc_impl(const Alloc& alloc, const char* fmt, std::size_t fmt_len,
+                  const FormatArg* args, std::size_t num_args) {
+    BasicFormatOutput<Alloc> out(alloc);
+    out.reserve(fmt_len + num_args * 16);
+    format_to_impl(out, fmt, fmt_len, args, num_args);
+    return out.finish();
+}
+
+} // namespace detail
+
+// format with the buffer and the result drawn from alloc
+template <typename Alloc, typename... Args>
+typename BasicFormatOutput<Alloc>::string_type
+format(std::allocator_arg_t, const Alloc& alloc, const char* fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    return detail::format_alloc_impl(alloc, fmt, std::strlen(fmt), arg_array, sizeof...(Args));
+}
+
+template <typename Alloc, typename... Args>
+typename BasicFormatOutput<Alloc>::string_type
+format(std::allocator_arg_t, const Alloc& alloc, const std::string& fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    return detail::format_alloc_impl(alloc, fmt.data(), fmt.size(), arg_array, sizeof...(Args));
+}
+
+#ifdef VITA_FORMAT_HAS_PMR
+namespace pmr {
+
+typedef BasicFormatOutput<std::pmr::polymorphic_allocator<char> > FormatOutput;
+
+template <typename... Args>
+std::pmr::string format(std::pmr::memory_resource* mr, const char* fmt, Args&&... args) {
+    return Vita::format(std::allocator_arg, std::pmr::polymorphic_allocator<char>(mr),
+                        fmt, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+std::pmr::string format(std::pmr::memory_resource* mr, const std::string& fmt, Args&&... args) {
+    return Vita::format(std::allocator_arg, std::pmr::polymorphic_allocator<char>(mr),
+                        fmt, std::forward<Args>(args)...);
+}
+
+} // namespace pmr
+#endif
+
+} // namespace Vita
+
+#endif // VITA_ALLOC_OUTPUT_HPP
@@ -0,0 +1,387 @@
+// vita/async_logger.hpp - asynchronous logging frontend
+//
+// Usage:
+//   Vita::AsyncLogger log([](const char* data, std::size_t len) {
+//       std::fwrite(data, 1, len, stderr);
+//   });
+//   log.log("order {} filled at {:.2f}", id, price);   // returns immediately
+//   log.flush();                                        // barrier
+//
+// The calling thread only packs the arguments into a slot of a bounded
+// lock-free MPSC ring (Vyukov's sequence-numbered cells); string arguments
+// are copied into the slot, or into one heap block when they do not fit.
+// Formatting runs on a background thread, which formats each record as a
+// line and hands the sink batches of up to batch_size bytes. The format
+// string must be a literal; only its address is stored.
+//
+// When the ring is full, ASYNC_BLOCK waits for the consumer, ASYNC_DROP
+// discards the record (log() returns false) and ASYNC_GROW moves it to an
+// unbounded overflow list. In every mode, records from one thread reach
+// the sink in order.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_ASYNC_LOGGER_HPP
+#define VITA_ASYNC_LOGGER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "format.hpp"
+
+#ifndef VITA_FORMAT_ASYNC_MAX_ARGS
+#define VITA_FORMAT_ASYNC_MAX_ARGS 8
+#endif
+
+// bytes of string arguments stored inside a ring slot
+#ifndef VITA_FORMAT_ASYNC_INLINE_TEXT
+#define VITA_FORMAT_ASYNC_INLINE_TEXT 192
+#endif
+
+namespace Vita {
+
+enum AsyncBackpressure { ASYNC_BLOCK, ASYNC_DROP, ASYNC_GROW };
+
+struct AsyncLoggerOptions {
+    std::size_t capacity;        // ring slots, rounded up to a power of two
+    AsyncBackpressure backpressure;
+    std::size_t batch_size;      // bytes formatted before the sink is called
+    std::chrono::microseconds idle_sleep;   // consumer poll interval when idle
+
+    AsyncLoggerOptions()
+        : capacity(4096), backpressure(ASYNC_BLOCK), batch_size(64 * 1024), idle_sleep(50) {}
+};
+
+namespace detail {
+
+struct AsyncRecord {
+    enum { FLUSH = 0xFF };
+
+    const char* fmt;
+    std::size_t fmt_len;
+    unsigned num_args;           // FLUSH marks a barrier
+    char* spill;                 // strings that did not fit in text
+    bool* done;                  // set by the consumer when a barrier is reached
+    FormatArg args[VITA_FORMAT_ASYNC_MAX_ARGS];
+    char text[VITA_FORMAT_ASYNC_INLINE_TEXT];
+
+    // rewrite arguments that refer to the caller's memory as views of
+    // copies owned by the record
+    void capture_strings() {
+        std::size_t total = 0;
+        bool any = false;
+        FormatArg::StringView v;
+        for (unsigned i = 0; i < num_args; ++i) {
+            if (borrowed_text(args[i], v)) {
+                total += v.size;
+                any = true;
+            }
+        }
+        if (!any) return;
+
+        char* p = text;
+        if (total > sizeof(text)) {
+            spill = new char[total];
+            note_alloc(total, false);
+            p = spill;
+        }
+        for (unsigned i = 0; i < num_args; ++i) {
+            if (!borrowed_text(args[i], v)) continue;
+            std::memcpy(p, v.data, v.size);
+            args[i] = FormatArg(p, v.size);
+            p += v.size;
+        }
+    }
+
+    void release() {
+        delete[] spill;
+        spill = 0;
+    }
+
+    // the text an argument reads from memory it does not own; every type
+    // is listed so that a new one has to be classified here
+    static bool borrowed_text(const FormatArg& arg, FormatArg::StringView& v) {
+        switch (arg.type()) {
+        case FormatArg::CSTRING:
+            if (!arg.as_cstring()) return false;
+            v.data = arg.as_cstring();
+            v.size = std::strlen(v.data);
+            return true;
+        case FormatArg::STRING:
+            v.data = arg.as_string()->data();
+            v.size = arg.as_string()->size();
+            return true;
+        case FormatArg::STRING_VIEW:
+            v = arg.as_view();
+            return true;
+        case FormatArg::NONE:
+        case FormatArg::BOOL:
+        case FormatArg::CHAR:
+        case FormatArg::INT:
+        case FormatArg::UINT:
+        case FormatArg::LLONG:
+        case FormatArg::ULLONG:
+        case FormatArg::DOUBLE:
+        case FormatArg::LDOUBLE:
+        case FormatArg::POINTER:     // only the address is formatted
+        case FormatArg::CUSTOM:      // formatted as a placeholder
+            return false;
+        }
+        return false;
+    }
+};
+
+// cache-line aligned so a producer filling one cell does not contend with
+// the consumer reading its neighbour
+struct alignas(64) AsyncCell {
+    std::atomic<std::size_t> seq;
+    AsyncRecord record;
+};
+
+} // namespace detail
+
+class AsyncLogger {
+public:
+    typedef std::function<void(const char* data, std::size_t len)> Sink;
+
+    explicit AsyncLogger(Sink sink, const AsyncLoggerOptions& opts = AsyncLoggerOptions())
+        : sink_(sink), opts_(opts), storage_(0), cells_(0), mask_(0), enqueue_pos_(0), dequeue_pos_(0),
+          overflowing_(false), stop_(false), dropped_(0)
+    {
+        std::size_t n = 2;
+        while (n < opts_.capacity) n <<= 1;
+        // aligned by hand, operator new only honours extended alignment from C++17
+        storage_ = new char[n * sizeof(detail::AsyncCell) + 64];
+        std::uintptr_t base = (reinterpret_cast<std::uintptr_t>(storage_) + 63) & ~std::uintptr_t(63);
+        cells_ = reinterpret_cast<detail::AsyncCell*>(base);
+        mask_ = n - 1;
+        for (std::size_t i = 0; i < n; ++i) {
+            new (&cells_[i]) detail::AsyncCell;
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        consumer_ = std::thread(&AsyncLogger::consumer_loop, this);
+    }
+
+    // drains every record logged before destruction
+    ~AsyncLogger() {
+        stop_.store(true, std::memory_order_release);
+        consumer_.join();
+        delete[] storage_;   // cells are trivially destructible
+    }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    // false only when ASYNC_DROP discarded the record
+    template <std::size_t N, typename... Args>
+    bool log(const char (&fmt)[N], Args&&... args) {
+        static_assert(sizeof...(Args) <= VITA_FORMAT_ASYNC_MAX_ARGS,
+            "Vita::AsyncLogger - too many arguments, raise VITA_FORMAT_ASYNC_MAX_ARGS");
+
+        if (opts_.backpressure == ASYNC_GROW && overflowing_.load())
+            return push_overflow(fmt, N - 1, std::forward<Args>(args)...);
+
+        std::size_t pos;
+        detail::AsyncCell* cell = claim(pos, opts_.backpressure == ASYNC_BLOCK);
+        if (!cell) {
+            if (opts_.backpressure == ASYNC_GROW)
+                return push_overflow(fmt, N - 1, std::forward<Args>(args)...);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        fill(cell->record, fmt, N - 1, std::forward<Args>(args)...);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // wait until everything logged before the call has reached the sink
+    void flush() {
+        bool done = false;
+        detail::AsyncRecord marker = detail::AsyncRecord();
+        marker.num_args = detail::AsyncRecord::FLUSH;
+        marker.done = &done;
+        if (opts_.backpressure == ASYNC_GROW && overflowing_.load()) {
+            push_record(marker);
+        } else {
+            std::size_t pos;
+            detail::AsyncCell* cell = claim(pos, opts_.backpressure != ASYNC_GROW);
+            if (cell) {
+                cell->record = marker;
+                cell->seq.store(pos + 1, std::memory_order_release);
+            } else {
+                push_record(marker);
+            }
+        }
+        std::unique_lock<std::mutex> lock(flush_mutex_);
+        flush_cv_.wait(lock, [&done]() { return done; });
+    }
+
+    std::size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    // reserve the next cell; when blocking, yields until the consumer frees one
+    detail::AsyncCell* claim(std::size_t& pos, bool block) {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            detail::AsyncCell* cell = &cells_[pos & mask_];
+            std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1))
+                    return cell;
+            } else if (diff < 0) {
+                if (!block) return 0;
+                std::this_thread::yield();
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    template <typename... Args>
+    static void fill(detail::AsyncRecord& r, const char* fmt, std::size_t fmt_len, Args&&... args) {
+        r.fmt = fmt;
+        r.fmt_len = fmt_len;
+        r.num_args = sizeof...(Args);
+        r.spill = 0;
+        r.done = 0;
+        detail::pack_args(r.args, std::forward<Args>(args)...);
+        r.capture_strings();
+    }
+
+    template <typename... Args>
+    bool push_overflow(const char* fmt, std::size_t fmt_len, Args&&... args) {
+        detail::AsyncRecord r;
+        fill(r, fmt, fmt_len, std::forward<Args>(args)...);
+        push_record(r);
+        return true;
+    }
+
+    // spill records keep their heap block; inline text moves with the copy
+    void push_record(const detail::AsyncRecord& r) {
+        detail::AsyncRecord* copy = new detail::AsyncRecord(r);
+        rebase_text(*copy, r);
+        std::lock_guard<std::mutex> lock(overflow_mutex_);
+        overflow_.push_back(copy);
+        overflowing_.store(true);
+    }
+
+    static void rebase_text(detail::AsyncRecord& to, const detail::AsyncRecord& from) {
+        if (to.num_args == detail::AsyncRecord::FLUSH) return;
+        for (unsigned i = 0; i < to.num_args; ++i) {
+            if (to.args[i].type() != detail::FormatArg::STRING_VIEW) continue;
+            detail::FormatArg::StringView v = to.args[i].as_view();
+            if (v.data >= from.text && v.data < from.text + sizeof(from.text))
+                to.args[i] = detail::FormatArg(to.text + (v.data - from.text), v.size);
+        }
+    }
+
+    bool pop(std::size_t limit, detail::OutputBase& out) {
+        if (dequeue_pos_ == limit) return false;
+        detail::AsyncCell* cell = &cells_[dequeue_pos_ & mask_];
+        // a producer has claimed this cell but not published it yet
+        while (cell->seq.load(std::memory_order_acquire) != dequeue_pos_ + 1)
+            std::this_thread::yield();
+        consume(cell->record, out);
+        cell->seq.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+        ++dequeue_pos_;
+        return true;
+    }
+
+    void consume(detail::AsyncRecord& r, detail::OutputBase& out) {
+        if (r.num_args == detail::AsyncRecord::FLUSH) {
+            emit(out);
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            *r.done = true;
+            flush_cv_.notify_all();
+            return;
+        }
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+        try {
+            detail::format_to_impl(out, r.fmt, r.fmt_len, r.args, r.num_args);
+        } catch (const std::exception&) {
+            out.append("{error}", 7);
+        }
+#else
+        detail::format_to_impl(out, r.fmt, r.fmt_len, r.args, r.num_args);
+#endif
+        out.append('\n');
+        r.release();
+        if (out.size() >= opts_.batch_size) emit(out);
+    }
+
+    void emit(detail::OutputBase& out) {
+        if (out.size() == 0) return;
+        sink_(out.data(), out.size());
+        out.shrink(out.size());
+    }
+
+    void consumer_loop() {
+        detail::FormatOutput out;
+        std::vector<detail::AsyncRecord*> batch;
+        for (;;) {
+            bool stopping = stop_.load(std::memory_order_acquire);
+            bool busy = false;
+
+            while (pop(enqueue_pos_.load(), out)) busy = true;
+
+            if (overflowing_.load()) {
+                // records claimed in the ring before the swap are older than
+                // the overflow batch, later ones are newer
+                std::size_t limit;
+                {
+                    std::lock_guard<std::mutex> lock(overflow_mutex_);
+                    batch.swap(overflow_);
+                    limit = enqueue_pos_.load();
+                    overflowing_.store(false);
+                }
+                while (pop(limit, out)) {}
+                for (std::size_t i = 0; i < batch.size(); ++i) {
+                    consume(*batch[i], out);
+                    delete batch[i];
+                }
+                batch.clear();
+                busy = true;
+            }
+
+            emit(out);
+            if (busy) continue;
+            if (stopping) break;
+            std::this_thread::sleep_for(opts_.idle_sleep);
+        }
+    }
+
+    Sink sink_;
+    AsyncLoggerOptions opts_;
+    char* storage_;
+    detail::AsyncCell* cells_;
+    std::size_t mask_;
+
+    char pad0_[64];
+    std::atomic<std::size_t> enqueue_pos_;
+    char pad1_[64];
+    std::size_t dequeue_pos_;    // consumer thread only
+
+    std::atomic<bool> overflowing_;
+    std::mutex overflow_mutex_;
+    std::vector<detail::AsyncRecord*> overflow_;
+
+    std::atomic<bool> stop_;
+    std::atomic<std::size_t> dropped_;
+
+    std::mutex flush_mutex_;
+    std::condition_variable flush_cv_;
+
+    std::thread consumer_;
+};
+
+} // namespace Vita
+
+#endif // VITA_ASYNC_LOGGER_HPP
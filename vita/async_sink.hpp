@@ -0,0 +1,560 @@
+// vita/async_sink.hpp - non-blocking file sink on io_uring
+//
+// Usage:
+//   Vita::AsyncSink sink("app.log");
+//   sink.println("{} {} latency={}ms", ts, level, ms);   // never blocks
+//
+//   // C++20 coroutines: resume once the line is in the file
+//   co_await sink.println("request {} done", id);
+//
+// print() formats on the calling thread and copies the bytes into one of
+// a few page-aligned buffers; it never waits for the disk. Full buffers are
+// handed to a background thread, which submits every buffer queued since
+// its last pass with a single io_uring_enter, as writes from buffers
+// registered with the ring (IORING_OP_WRITE_FIXED), each at its own file
+// offset, so writes may complete in any order. Partially filled buffers are
+// submitted after flush_interval. Where io_uring is unavailable (not Linux,
+// an old kernel, or blocked by a seccomp policy) or options.io_uring is
+// false, the same thread writes the buffers with pwrite instead.
+//
+// When every buffer is in flight, further output waits in an overflow
+// buffer that grows as needed. print() returns a Ticket for its bytes:
+// wait() blocks until they are written and, with C++20 coroutines,
+// co_await suspends the coroutine instead and resumes it on the sink's
+// thread. Awaiting a ticket submits its partially filled buffer at once.
+// Awaiting each print bounds memory by pacing the writer to the disk.
+// Write errors set failed() and count as written, so waiters never hang.
+// A coroutine resumed on the sink's thread must co_await rather than call
+// wait() or flush(), which would wait for that same thread.
+//
+// POSIX only. Appends to the file, which must not be written by anything
+// else while the sink is open.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_ASYNC_SINK_HPP
+#define VITA_ASYNC_SINK_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "format.hpp"
+#include "detail/io_uring.hpp"
+#include "detail/pages.hpp"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#define VITA_FORMAT_HAS_COROUTINES 1
+#endif
+
+namespace Vita {
+
+struct AsyncSinkOptions {
+    std::size_t buffer_size;     // bytes per buffer, rounded up to whole pages
+    unsigned buffers;            // buffers, registered with the ring when possible
+    std::chrono::milliseconds flush_interval;   // partial buffers are submitted after this
+    bool io_uring;               // false always uses the pwrite thread
+
+    AsyncSinkOptions() : buffer_size(64 << 10), buffers(8), flush_interval(100), io_uring(true) {}
+};
+
+enum AsyncBackend { BACKEND_IO_URING, BACKEND_THREAD };
+
+namespace detail {
+
+enum AsyncSlotState { SLOT_FREE, SLOT_FILLING, SLOT_QUEUED, SLOT_IN_FLIGHT };
+
+struct AsyncSlot {
+    char* data;
+    std::size_t size;
+    std::size_t done;            // bytes written so far, after short writes
+    std::uint64_t start;         // stream position of data[0]
+    AsyncSlotState state;
+};
+
+struct AsyncWaiter {
+    std::uint64_t end;
+    void (*resume)(void* ctx);
+    void* ctx;
+};
+
+} // namespace detail
+
+class AsyncSink {
+public:
+    // the bytes of one print(); done once they have reached the file
+    class Ticket {
+    public:
+        bool done() const noexcept { return sink_->written() >= end_; }
+        void wait() const { sink_->wait_for(end_); }
+
+#if VITA_FORMAT_HAS_COROUTINES
+        bool await_ready() const noexcept { return done(); }
+        bool await_suspend(std::coroutine_handle<> h) {
+            return sink_->suspend(end_, &Ticket::resume_handle, h.address());
+        }
+        void await_resume() const noexcept {}
+#endif
+
+    private:
+        friend class AsyncSink;
+        Ticket(AsyncSink* sink, std::uint64_t end) : sink_(sink), end_(end) {}
+
+#if VITA_FORMAT_HAS_COROUTINES
+        static void resume_handle(void* address) { std::coroutine_handle<>::from_address(address).resume(); }
+#endif
+
+        AsyncSink* sink_;
+        std::uint64_t end_;
+    };
+
+    explicit AsyncSink(const std::string& path, const AsyncSinkOptions& opts = AsyncSinkOptions())
+        : path_(path), opts_(opts), fd_(-1), base_(0), memory_(0), backend_(BACKEND_THREAD),
+          registered_(false), filling_(-1), in_flight_(0), overflow_pos_(0),
+          accepted_(0), awaited_(0), stop_(false), written_(0), failed_(false)
+    {
+        opts_.buffer_size = detail::round_to_pages(opts_.buffer_size);
+        if (opts_.buffers == 0) opts_.buffers = 1;
+        open_file();
+
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+        try {
+            start();
+        } catch (...) {
+#if VITA_FORMAT_HAS_IO_URING
+            ring_.close();
+#endif
+            std::free(memory_);
+            if (fd_ >= 0) ::close(fd_);
+            throw;
+        }
+#else
+        start();
+#endif
+    }
+
+    // writes everything still buffered before returning
+    ~AsyncSink() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        io_cv_.notify_one();
+        io_thread_.join();
+#if VITA_FORMAT_HAS_IO_URING
+        ring_.close();
+#endif
+        if (fd_ >= 0) ::close(fd_);
+        std::free(memory_);
+    }
+
+    AsyncSink(const AsyncSink&) = delete;
+    AsyncSink& operator=(const AsyncSink&) = delete;
+
+    template <typename... Args>
+    Ticket print(const char* fmt, Args&&... args) {
+        detail::FormatOutput out;
+        format_to(out, fmt, std::forward<Args>(args)...);
+        return append(out.data(), out.size());
+    }
+
+    template <typename... Args>
+    Ticket println(const char* fmt, Args&&... args) {
+        detail::FormatOutput out;
+        format_to(out, fmt, std::forward<Args>(args)...);
+        out.append('\n');
+        return append(out.data(), out.size());
+    }
+
+    // copy pre-formatted bytes; a message may straddle two buffers
+    Ticket append(const char* data, std::size_t len) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bool queued = false;
+        while (len) {
+            if (overflow_left() || (filling_ < 0 && free_.empty())) {
+                overflow_.append(data, len);
+                accepted_ += len;
+                break;
+            }
+            if (filling_ < 0) take_free(accepted_);
+            detail::AsyncSlot& s = slots_[static_cast<std::size_t>(filling_)];
+            std::size_t n = opts_.buffer_size - s.size < len ? opts_.buffer_size - s.size : len;
+            std::memcpy(s.data + s.size, data, n);
+            s.size += n;
+            accepted_ += n;
+            data += n;
+            len -= n;
+            if (s.size == opts_.buffer_size) {
+                queue_slot(filling_);
+                queued = true;
+            }
+        }
+        Ticket ticket(this, accepted_);
+        lock.unlock();
+        if (queued) io_cv_.notify_one();
+        return ticket;
+    }
+
+    // block until everything appended so far has been written to the file
+    void flush() {
+        std::uint64_t target;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            target = accepted_;
+        }
+        wait_for(target);
+    }
+
+    // bytes written to the file, counting from the first byte of this sink
+    std::uint64_t written() const noexcept { return written_.load(std::memory_order_acquire); }
+
+    const std::string& path() const { return path_; }
+    // BACKEND_THREAD once a failed ring has been replaced by pwrite
+    AsyncBackend backend() const noexcept { return backend_.load(std::memory_order_relaxed); }
+    bool registered_buffers() const noexcept { return registered_; }
+    bool failed() const { return failed_.load(std::memory_order_relaxed); }
+
+private:
+    void open_file() {
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            failed_.store(true, std::memory_order_relaxed);
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+            throw std::runtime_error("Vita::AsyncSink: cannot open " + path_);
+#else
+            return;
+#endif
+        }
+        off_t end = ::lseek(fd_, 0, SEEK_END);
+        base_ = end > 0 ? static_cast<std::uint64_t>(end) : 0;
+    }
+
+    // buffers, ring and io thread; the constructor releases the file and
+    // the buffers if this throws
+    void start() {
+        void* p = 0;
+        if (::posix_memalign(&p, detail::page_size(), opts_.buffer_size * opts_.buffers) != 0)
+            throw std::bad_alloc();
+        memory_ = static_cast<char*>(p);
+        slots_.resize(opts_.buffers);
+        iov_.resize(opts_.buffers);
+        in_ring_.assign(opts_.buffers, 0);
+        for (unsigned i = 0; i < opts_.buffers; ++i) {
+            detail::AsyncSlot& s = slots_[i];
+            s.data = memory_ + i * opts_.buffer_size;
+            s.size = s.done = 0;
+            s.start = 0;
+            s.state = detail::SLOT_FREE;
+            free_.push_back(opts_.buffers - 1 - i);
+            iov_[i].iov_base = s.data;
+            iov_[i].iov_len = opts_.buffer_size;
+        }
+
+#if VITA_FORMAT_HAS_IO_URING
+        if (opts_.io_uring && fd_ >= 0 && ring_.open(opts_.buffers)) {
+            backend_.store(BACKEND_IO_URING, std::memory_order_relaxed);
+            registered_ = ring_.register_buffers(iov_.data(), opts_.buffers);
+        }
+#endif
+        io_thread_ = std::thread(&AsyncSink::io_loop, this);
+    }
+
+    std::size_t overflow_left() const { return overflow_.size() - overflow_pos_; }
+
+    void take_free(std::uint64_t start) {
+        unsigned i = free_.back();
+        free_.pop_back();
+        detail::AsyncSlot& s = slots_[i];
+        s.size = s.done = 0;
+        s.start = start;
+        s.state = detail::SLOT_FILLING;
+        filling_ = static_cast<int>(i);
+    }
+
+    void queue_slot(int i) {
+        slots_[static_cast<std::size_t>(i)].state = detail::SLOT_QUEUED;
+        queue_.push_back(static_cast<unsigned>(i));
+        if (i == filling_) filling_ = -1;
+    }
+
+    // submit the partially filled buffer now if it holds bytes before end
+    void kick(std::uint64_t end) {
+        if (filling_ < 0) return;
+        const detail::AsyncSlot& s = slots_[static_cast<std::size_t>(filling_)];
+        if (s.size && s.start < end) queue_slot(filling_);
+    }
+
+    // the bytes before end are awaited; bytes still in the overflow buffer
+    // are submitted as soon as they move into a slot
+    void await(std::uint64_t end) {
+        if (end > awaited_) awaited_ = end;
+        kick(end);
+    }
+
+    void wait_for(std::uint64_t end) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (written() >= end) return;
+        await(end);
+        io_cv_.notify_one();
+        done_cv_.wait(lock, [this, end]() { return written() >= end; });
+    }
+
+    // false if the bytes were written in the meantime
+    bool suspend(std::uint64_t end, void (*resume)(void*), void* ctx) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (written() >= end) return false;
+        await(end);
+        detail::AsyncWaiter w = { end, resume, ctx };
+        waiters_.push_back(w);
+        lock.unlock();
+        io_cv_.notify_one();
+        return true;
+    }
+
+    void io_loop() {
+        std::vector<unsigned> batch;
+        std::vector<unsigned> finished;
+        std::vector<detail::AsyncWaiter> ready;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            if (queue_.empty() && in_flight_ == 0) {
+                if (!stop_ && io_cv_.wait_for(lock, opts_.flush_interval) == std::cv_status::no_timeout)
+                    continue;
+                if (!queue_.empty()) continue;
+                if (filling_ >= 0 && slots_[static_cast<std::size_t>(filling_)].size) {
+                    queue_slot(filling_);
+                    continue;
+                }
+                if (stop_) break;
+                continue;
+            }
+
+            batch.swap(queue_);
+            for (std::size_t i = 0; i < batch.size(); ++i)
+                slots_[batch[i]].state = detail::SLOT_IN_FLIGHT;
+            in_flight_ += batch.size();
+            lock.unlock();
+
+            write_slots(batch, finished);
+            batch.clear();
+
+            lock.lock();
+            for (std::size_t i = 0; i < finished.size(); ++i) {
+                detail::AsyncSlot& s = slots_[finished[i]];
+                s.state = detail::SLOT_FREE;
+                s.size = s.done = 0;
+                free_.push_back(finished[i]);
+            }
+            in_flight_ -= finished.size();
+            finished.clear();
+            refill_from_overflow();
+            kick(awaited_);
+            update_written();
+            done_cv_.notify_all();
+
+            for (std::size_t i = 0; i < waiters_.size();) {
+                if (waiters_[i].end <= written()) {
+                    ready.push_back(waiters_[i]);
+                    waiters_[i] = waiters_.back();
+                    waiters_.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+            if (!ready.empty()) {
+                lock.unlock();
+                for (std::size_t i = 0; i < ready.size(); ++i) ready[i].resume(ready[i].ctx);
+                ready.clear();
+                lock.lock();
+            }
+        }
+    }
+
+    // buffers that waited for a free slot move into slots in stream order
+    void refill_from_overflow() {
+        while (overflow_left() && !free_.empty()) {
+            take_free(accepted_ - overflow_left());
+            detail::AsyncSlot& s = slots_[static_cast<std::size_t>(filling_)];
+            std::size_t n = overflow_left() < opts_.buffer_size ? overflow_left() : opts_.buffer_size;
+            std::memcpy(s.data, overflow_.data() + overflow_pos_, n);
+            s.size = n;
+            overflow_pos_ += n;
+            if (s.size == opts_.buffer_size) queue_slot(filling_);
+        }
+        if (!overflow_left()) {
+            overflow_.clear();
+            overflow_pos_ = 0;
+        }
+    }
+
+    // everything before the first byte still buffered has been written
+    void update_written() {
+        std::uint64_t w = accepted_ - overflow_left();
+        for (std::size_t i = 0; i < slots_.size(); ++i)
+            if (slots_[i].state != detail::SLOT_FREE && slots_[i].start < w) w = slots_[i].start;
+        written_.store(w, std::memory_order_release);
+    }
+
+    // runs on the io thread without the lock; in-flight slots belong to it
+    // returns with at least one slot in finished
+    void write_slots(const std::vector<unsigned>& batch, std::vector<unsigned>& finished) {
+#if VITA_FORMAT_HAS_IO_URING
+        if (backend() == BACKEND_IO_URING) {
+            for (std::size_t i = 0; i < batch.size(); ++i) submit_slot(batch[i]);
+            while (finished.empty()) {
+                if (ring_.submit(1) < 0) {
+                    abandon_ring(finished);
+                    return;
+                }
+                std::uint64_t user_data;
+                int res;
+                while (ring_.complete(user_data, res)) {
+                    unsigned i = static_cast<unsigned>(user_data);
+                    detail::AsyncSlot& s = slots_[i];
+                    if (res == -EINTR || res == -EAGAIN) {
+                        submit_slot(i);
+                        continue;
+                    }
+                    if (res < 0) {
+                        failed_.store(true, std::memory_order_relaxed);
+                        s.done = s.size;
+                    } else {
+                        s.done += static_cast<std::size_t>(res);
+                    }
+                    if (res == 0 && s.done < s.size) {
+                        failed_.store(true, std::memory_order_relaxed);
+                        s.done = s.size;
+                    }
+                    if (s.done < s.size) {
+                        submit_slot(i);
+                    } else {
+                        in_ring_[i] = 0;
+                        finished.push_back(i);
+                    }
+                }
+            }
+            return;
+        }
+#endif
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            pwrite_slot(slots_[batch[i]]);
+            finished.push_back(batch[i]);
+        }
+    }
+
+#if VITA_FORMAT_HAS_IO_URING
+    // the ring is unusable: let the kernel finish the writes it has taken,
+    // since their buffers are still in use, then close the ring and finish
+    // everything with pwrite
+    void abandon_ring(std::vector<unsigned>& finished) {
+        backend_.store(BACKEND_THREAD, std::memory_order_relaxed);
+        std::vector<char> owned(in_ring_);
+        std::vector<std::uint64_t> queued(opts_.buffers);
+        queued.resize(ring_.unconsumed(queued.data(), queued.size()));
+        for (std::size_t q = 0; q < queued.size(); ++q)
+            owned[static_cast<std::size_t>(queued[q])] = 0;
+
+        std::size_t taken = 0;
+        for (unsigned i = 0; i < opts_.buffers; ++i) taken += owned[i] ? 1 : 0;
+        while (taken) {
+            std::uint64_t user_data;
+            int res;
+            if (!ring_.complete(user_data, res)) {
+                if (ring_.wait() < 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            unsigned i = static_cast<unsigned>(user_data);
+            if (res > 0) slots_[i].done += static_cast<std::size_t>(res);
+            if (owned[i]) {
+                owned[i] = 0;
+                --taken;
+            }
+        }
+        ring_.close();
+
+        for (unsigned i = 0; i < opts_.buffers; ++i)
+            if (in_ring_[i]) {
+                in_ring_[i] = 0;
+                pwrite_slot(slots_[i]);
+                finished.push_back(i);
+            }
+    }
+
+    void submit_slot(unsigned i) {
+        detail::AsyncSlot& s = slots_[i];
+        const char* p = s.data + s.done;
+        unsigned n = static_cast<unsigned>(s.size - s.done);
+        std::uint64_t offset = base_ + s.start + s.done;
+        in_ring_[i] = 1;
+        if (registered_) {
+            ring_.write_fixed(fd_, p, n, offset, i, i);
+        } else {
+            iov_[i].iov_base = const_cast<char*>(p);
+            iov_[i].iov_len = n;
+            ring_.writev(fd_, &iov_[i], offset, i);
+        }
+    }
+#endif
+
+    void pwrite_slot(detail::AsyncSlot& s) {
+        while (s.done < s.size) {
+            ssize_t n = ::pwrite(fd_, s.data + s.done, s.size - s.done,
+                                 static_cast<off_t>(base_ + s.start + s.done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                failed_.store(true, std::memory_order_relaxed);
+                return;
+            }
+            s.done += static_cast<std::size_t>(n);
+        }
+    }
+
+    std::string path_;
+    AsyncSinkOptions opts_;
+    int fd_;
+    std::uint64_t base_;         // file size when the sink was opened
+    char* memory_;
+    std::atomic<AsyncBackend> backend_;   // set back to BACKEND_THREAD by the io thread
+    bool registered_;
+#if VITA_FORMAT_HAS_IO_URING
+    detail::IoRing ring_;
+#endif
+    std::vector<struct iovec> iov_;
+
+    // owned by the io thread after construction
+    std::vector<char> in_ring_;  // slots with a write in the ring
+
+    std::mutex mutex_;
+    std::condition_variable io_cv_;
+    std::condition_variable done_cv_;
+    std::vector<detail::AsyncSlot> slots_;
+    std::vector<unsigned> free_;
+    std::vector<unsigned> queue_;
+    int filling_;
+    std::size_t in_flight_;
+    std::string overflow_;
+    std::size_t overflow_pos_;
+    std::uint64_t accepted_;     // stream bytes appended so far
+    std::uint64_t awaited_;      // highest end a wait() or co_await asked for
+    std::vector<detail::AsyncWaiter> waiters_;
+    bool stop_;
+
+    std::atomic<std::uint64_t> written_;
+    std::atomic<bool> failed_;
+    std::thread io_thread_;
+};
+
+} // namespace Vita
+
+#endif // VITA_ASYNC_SINK_HPP
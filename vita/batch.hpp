@@ -0,0 +1,495 @@
+// vita/batch.hpp - format many records with one format, in order
+//
+// Usage:
+//   static const Vita::CompiledFormat row("{},{},{:.6f}\n");
+//   std::vector<std::tuple<int, std::string, double> > records = ...;
+//   Vita::format_batch(row, records, [](const char* data, std::size_t len) {
+//       std::fwrite(data, 1, len, out);
+//   });
+//
+//   Vita::format_records(out, row, records);                  // this thread
+//   Vita::format_columns(out, row, n, ids, names, scores);    // arrays
+//
+// Before the first record, the compiled format is resolved against the
+// record's field types: every placeholder becomes a direct call to a
+// writer for that type and spec (plain integers and floating point skip
+// the spec handling altogether). The loop over records then only makes
+// those calls, without packing arguments or switching on their types.
+// format_records runs it on the calling thread over an array of records;
+// format_columns does the same over a struct of arrays, where record i is
+// (columns[0][i], columns[1][i], ...).
+//
+// format_batch splits the records into chunks of chunk_records. Worker
+// threads take the next unformatted chunk from a shared counter, so a
+// thread that finishes early keeps taking work until none is left, and
+// format it into one of a ring of reusable chunk buffers. The calling
+// thread hands the buffers to the sink in input order while the workers
+// format the chunks after them; at most threads * max_pending formatted
+// chunks wait for the sink, which bounds memory. The sink sees exactly
+// the bytes a serial loop would produce.
+//
+// A record is a std::tuple or std::pair of the arguments, or a single
+// argument. Records must stay valid until format_batch returns. An
+// exception from the sink or from formatting stops the workers and is
+// rethrown from format_batch.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_BATCH_HPP
+#define VITA_BATCH_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "compiled_format.hpp"
+
+namespace Vita {
+
+struct BatchOptions {
+    unsigned threads;            // formatting threads, 0 = hardware concurrency
+    std::size_t chunk_records;   // records formatted as one unit of work
+    std::size_t max_pending;     // formatted chunks per thread waiting for the sink
+
+    BatchOptions() : threads(0), chunk_records(4096), max_pending(2) {}
+};
+
+namespace detail {
+
+template <std::size_t... I>
+struct IndexList {};
+
+template <std::size_t N, std::size_t... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+
+template <std::size_t... I>
+struct MakeIndexList<0, I...> {
+    typedef IndexList<I...> type;
+};
+
+template <typename R>
+struct RecordArity {
+    enum { value = 1 };
+};
+
+template <typename... T>
+struct RecordArity<std::tuple<T...> > {
+    enum { value = sizeof...(T) };
+};
+
+template <typename A, typename B>
+struct RecordArity<std::pair<A, B> > {
+    enum { value = 2 };
+};
+
+typedef void (*BatchChunkFn)(const void* job, OutputBase& out, std::size_t begin, std::size_t end);
+typedef void (*BatchSinkFn)(void* sink, const char* data, std::size_t len);
+
+struct BatchSlot {
+    FormatOutput out;
+    bool ready;
+
+    BatchSlot() : ready(false) {}
+};
+
+class BatchRun {
+public:
+    BatchRun(std::size_t chunks, std::size_t per_chunk, std::size_t count, std::size_t slots,
+             BatchChunkFn format_chunk, const void* job)
+        : chunks_(chunks), per_chunk_(per_chunk), count_(count), num_slots_(slots),
+          slots_(new BatchSlot[slots]), format_chunk_(format_chunk), job_(job),
+          next_(0), written_(0), failed_(false) {}
+
+    void work() {
+        for (;;) {
+            std::size_t c = next_.fetch_add(1, std::memory_order_relaxed);
+            if (c >= chunks_) return;
+            BatchSlot& slot = slots_[c % num_slots_];
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (written_ + num_slots_ <= c && !failed_) slot_free_.wait(lock);
+                if (failed_) return;
+            }
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+            try {
+                format_into(slot, c);
+            } catch (...) {
+                fail(std::current_exception());
+                return;
+            }
+#else
+            format_into(slot, c);
+#endif
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot.ready = true;
+            if (c == written_) chunk_ready_.notify_one();
+        }
+    }
+
+    // hand the chunks to the sink in order; false if a worker failed
+    bool write(BatchSinkFn sink, void* sink_ctx) {
+        for (std::size_t c = 0; c < chunks_; ++c) {
+            BatchSlot& slot = slots_[c % num_slots_];
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (!slot.ready && !failed_) chunk_ready_.wait(lock);
+                if (failed_) return false;
+            }
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+            try {
+                sink(sink_ctx, slot.out.data(), slot.out.size());
+            } catch (...) {
+                fail(std::current_exception());
+                return false;
+            }
+#else
+            sink(sink_ctx, slot.out.data(), slot.out.size());
+#endif
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot.ready = false;
+            ++written_;
+            slot_free_.notify_all();
+        }
+        return true;
+    }
+
+    std::exception_ptr error() const { return error_; }
+
+private:
+    void format_into(BatchSlot& slot, std::size_t c) {
+        std::size_t begin = c * per_chunk_;
+        std::size_t end = begin + per_chunk_ < count_ ? begin + per_chunk_ : count_;
+        slot.out.shrink(slot.out.size());
+        format_chunk_(job_, slot.out, begin, end);
+    }
+
+    void fail(std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!failed_) error_ = e;
+        failed_ = true;
+        slot_free_.notify_all();
+        chunk_ready_.notify_all();
+    }
+
+    std::size_t chunks_;
+    std::size_t per_chunk_;
+    std::size_t count_;
+    std::size_t num_slots_;
+    std::unique_ptr<BatchSlot[]> slots_;
+    BatchChunkFn format_chunk_;
+    const void* job_;
+
+    std::atomic<std::size_t> next_;
+    std::mutex mutex_;
+    std::condition_variable slot_free_;
+    std::condition_variable chunk_ready_;
+    std::size_t written_;
+    bool failed_;
+    std::exception_ptr error_;
+};
+
+inline void run_batch(std::size_t count, const BatchOptions& options, BatchChunkFn format_chunk,
+                      const void* job, BatchSinkFn sink, void* sink_ctx) {
+    if (count == 0) return;
+    std::size_t per_chunk = options.chunk_records ? options.chunk_records : 1;
+    std::size_t chunks = (count + per_chunk - 1) / per_chunk;
+    std::size_t threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    if (threads > chunks) threads = chunks;
+
+    if (threads == 1) {
+        FormatOutput out;
+        for (std::size_t begin = 0; begin < count; begin += per_chunk) {
+            out.shrink(out.size());
+            format_chunk(job, out, begin, begin + per_chunk < count ? begin + per_chunk : count);
+            sink(sink_ctx, out.data(), out.size());
+        }
+        return;
+    }
+
+    std::size_t pending = options.max_pending ? options.max_pending : 1;
+    BatchRun run(chunks, per_chunk, count, threads * pending, format_chunk, job);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+        workers.push_back(std::thread(&BatchRun::work, &run));
+    run.write(sink, sink_ctx);
+    for (std::size_t i = 0; i < workers.size(); ++i) workers[i].join();
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+    if (run.error()) std::rethrow_exception(run.error());
+#endif
+}
+
+// fields of a record: element I of a tuple or pair, or the value itself
+template <std::size_t I, typename... T>
+inline const typename std::tuple_element<I, std::tuple<T...> >::type&
+record_field(const std::tuple<T...>& t) {
+    return std::get<I>(t);
+}
+
+template <std::size_t I, typename A, typename B>
+inline const typename std::tuple_element<I, std::pair<A, B> >::type&
+record_field(const std::pair<A, B>& p) {
+    return std::get<I>(p);
+}
+
+template <std::size_t I, typename T>
+inline const T& record_field(const T& value) {
+    return value;
+}
+
+// array of records: record i is records[i]
+template <typename Records>
+struct RowSource {
+    typedef typename std::decay<decltype(std::declval<const Records&>()[0])>::type Record;
+    enum { arity = RecordArity<Record>::value };
+
+    const Records* records;
+
+    template <std::size_t I>
+    auto get(std::size_t i) const -> decltype(record_field<I>((*records)[i])) {
+        return record_field<I>((*records)[i]);
+    }
+};
+
+// struct of arrays: record i is (columns[0][i], columns[1][i], ...)
+template <typename... T>
+struct ColumnSource {
+    enum { arity = sizeof...(T) };
+
+    std::tuple<const T*...> columns;
+
+    template <std::size_t I>
+    auto get(std::size_t i) const -> decltype(std::get<I>(columns)[i]) {
+        return std::get<I>(columns)[i];
+    }
+};
+
+// how a placeholder is written, decided once per format instead of per value
+enum FieldKind { FIELD_PLAIN, FIELD_FIXED, FIELD_SPEC };
+
+inline FieldKind field_kind(const FormatSpec& spec) {
+    if (spec.width > 0 || spec.sign != '-' || spec.alt_form) return FIELD_SPEC;
+    if (spec.type == '\0' && spec.precision < 0) return FIELD_PLAIN;
+    if (spec.type == 'f' || spec.type == 'F') return FIELD_FIXED;
+    return FIELD_SPEC;
+}
+
+template <int Kind>
+struct FieldKindTag {};
+
+// anything without a shortcut goes through format_arg
+template <typename T, int Kind>
+inline void write_field(OutputBase& out, const T& value, const FormatSpec& spec, FieldKindTag<Kind>) {
+    FormatArg arg;
+    pack_args(&arg, value);
+    format_arg(out, arg, spec);
+}
+
+template <typename T>
+inline void write_int_field(OutputBase& out, T value, std::true_type) {
+    char* p = out.grow(24);
+    out.shrink(24 - int_to_str(value, p));
+}
+
+template <typename T>
+inline void write_int_field(OutputBase& out, T value, std::false_type) {
+    char* p = out.grow(24);
+    out.shrink(24 - uint_to_str(value, p));
+}
+
+#define VITA_FORMAT_INT_FIELD(T) \
+    inline void write_field(OutputBase& out, T value, const FormatSpec&, FieldKindTag<FIELD_PLAIN>) { \
+        write_int_field(out, value, std::is_signed<T>()); \
+    }
+VITA_FORMAT_INT_FIELD(short)
+VITA_FORMAT_INT_FIELD(unsigned short)
+VITA_FORMAT_INT_FIELD(int)
+VITA_FORMAT_INT_FIELD(unsigned int)
+VITA_FORMAT_INT_FIELD(long)
+VITA_FORMAT_INT_FIELD(unsigned long)
+VITA_FORMAT_INT_FIELD(long long)
+VITA_FORMAT_INT_FIELD(unsigned long long)
+#undef VITA_FORMAT_INT_FIELD
+
+inline void write_field(OutputBase& out, double value, const FormatSpec&, FieldKindTag<FIELD_PLAIN>) {
+    char* p = out.grow(32);
+    out.shrink(32 - double_to_str_shortest(value, p));
+}
+
+inline void write_field(OutputBase& out, float value, const FormatSpec& spec, FieldKindTag<FIELD_PLAIN> tag) {
+    write_field(out, static_cast<double>(value), spec, tag);
+}
+
+inline void write_field(OutputBase& out, double value, const FormatSpec& spec, FieldKindTag<FIELD_FIXED>) {
+    char buffer[128];
+    int prec = spec.precision >= 0 ? spec.precision : 6;
+    if (prec > 64) {
+        format_arg(out, FormatArg(value), spec);
+        return;
+    }
+    out.append(buffer, double_to_str_fixed(value, buffer, prec));
+}
+
+inline void write_field(OutputBase& out, float value, const FormatSpec& spec, FieldKindTag<FIELD_FIXED> tag) {
+    write_field(out, static_cast<double>(value), spec, tag);
+}
+
+inline void write_field(OutputBase& out, bool value, const FormatSpec&, FieldKindTag<FIELD_PLAIN>) {
+    if (value) out.append("true", 4);
+    else out.append("false", 5);
+}
+
+inline void write_field(OutputBase& out, char value, const FormatSpec&, FieldKindTag<FIELD_PLAIN>) {
+    out.append(value);
+}
+
+// strings skip the argument switch whatever their spec
+template <int Kind>
+inline void write_field(OutputBase& out, const std::string& value, const FormatSpec& spec, FieldKindTag<Kind>) {
+    format_string(out, value.data(), value.size(), spec);
+}
+
+template <int Kind>
+inline void write_field(OutputBase& out, const char* value, const FormatSpec& spec, FieldKindTag<Kind>) {
+    if (value) format_string(out, value, std::strlen(value), spec);
+    else format_arg(out, FormatArg(value), spec);
+}
+
+template <typename Source>
+struct RecordStep {
+    typedef void (*FieldFn)(OutputBase& out, const Source& src, std::size_t i, const FormatSpec& spec);
+
+    FieldFn field;               // null for literal text
+    const char* text;
+    std::size_t length;
+    FormatSpec spec;
+};
+
+template <typename Source, std::size_t I, int Kind>
+void write_source_field(OutputBase& out, const Source& src, std::size_t i, const FormatSpec& spec) {
+    write_field(out, src.template get<I>(i), spec, FieldKindTag<Kind>());
+}
+
+template <typename Source, std::size_t... I>
+inline typename RecordStep<Source>::FieldFn field_writer(std::size_t index, FieldKind kind, IndexList<I...>) {
+    typedef typename RecordStep<Source>::FieldFn FieldFn;
+    static const FieldFn plain[] = { &write_source_field<Source, I, FIELD_PLAIN>... };
+    static const FieldFn fixed[] = { &write_source_field<Source, I, FIELD_FIXED>... };
+    static const FieldFn with_spec[] = { &write_source_field<Source, I, FIELD_SPEC>... };
+    return kind == FIELD_PLAIN ? plain[index] : kind == FIELD_FIXED ? fixed[index] : with_spec[index];
+}
+
+// the compiled format resolved against the field types of one input: each
+// placeholder becomes a call to a writer for its type and spec, so the
+// per-record loop neither packs arguments nor switches on their types
+template <typename Source>
+class RecordPlan {
+public:
+    explicit RecordPlan(const CompiledFormat& fmt) {
+        const std::vector<CompiledSegment>& segments = fmt.segments();
+        for (std::size_t i = 0; i < segments.size(); ++i) {
+            const CompiledSegment& seg = segments[i];
+            RecordStep<Source> step;
+            step.field = 0;
+            step.text = fmt.text() + seg.begin;
+            step.length = seg.length;
+            if (seg.arg_index >= 0) {
+                std::size_t index = static_cast<std::size_t>(seg.arg_index);
+                if (index < static_cast<std::size_t>(Source::arity)) {
+                    step.field = field_writer<Source>(index, field_kind(seg.spec),
+                                                      typename MakeIndexList<Source::arity>::type());
+                    step.spec = seg.spec;
+                } else {
+                    step.text = "{?}";
+                    step.length = 3;
+                }
+            }
+            steps_.push_back(step);
+        }
+    }
+
+    void run(OutputBase& out, const Source& src, std::size_t begin, std::size_t end) const {
+        const RecordStep<Source>* steps = steps_.data();
+        std::size_t n = steps_.size();
+        std::size_t start = out.size();
+        for (std::size_t i = begin; i < end; ++i) {
+            for (std::size_t s = 0; s < n; ++s) {
+                if (steps[s].field) steps[s].field(out, src, i, steps[s].spec);
+                else out.append(steps[s].text, steps[s].length);
+            }
+            // size the rest of the run from the first record
+            if (i == begin && end - begin > 1) out.reserve((out.size() - start) * (end - begin - 1));
+        }
+    }
+
+private:
+    std::vector<RecordStep<Source> > steps_;
+};
+
+template <typename Records>
+struct BatchJob {
+    typedef RowSource<Records> Source;
+
+    const RecordPlan<Source>* plan;
+    Source source;
+
+    static void format_chunk(const void* ctx, OutputBase& out, std::size_t begin, std::size_t end) {
+        const BatchJob& job = *static_cast<const BatchJob*>(ctx);
+        job.plan->run(out, job.source, begin, end);
+    }
+};
+
+template <typename Sink>
+inline void call_batch_sink(void* sink, const char* data, std::size_t len) {
+    (*static_cast<Sink*>(sink))(data, len);
+}
+
+} // namespace detail
+
+// format each record with fmt and pass the output to sink(const char*,
+// std::size_t) in record order, formatting on several threads
+template <typename Records, typename Sink>
+void format_batch(const CompiledFormat& fmt, const Records& records, Sink sink,
+                  const BatchOptions& options) {
+    typedef typename detail::BatchJob<Records>::Source Source;
+    detail::RecordPlan<Source> plan(fmt);
+    detail::BatchJob<Records> job = { &plan, { &records } };
+    detail::run_batch(records.size(), options, &detail::BatchJob<Records>::format_chunk, &job,
+                      &detail::call_batch_sink<Sink>, &sink);
+}
+
+template <typename Records, typename Sink>
+void format_batch(const CompiledFormat& fmt, const Records& records, Sink sink, unsigned threads = 0) {
+    BatchOptions options;
+    options.threads = threads;
+    format_batch(fmt, records, sink, options);
+}
+
+// format each record with fmt into out, in order, on the calling thread
+template <typename Records>
+void format_records(detail::OutputBase& out, const CompiledFormat& fmt, const Records& records) {
+    typedef detail::RowSource<Records> Source;
+    Source source = { &records };
+    detail::RecordPlan<Source>(fmt).run(out, source, 0, records.size());
+}
+
+// the same for a struct of arrays: record i is (columns[0][i], columns[1][i], ...)
+template <typename... T>
+void format_columns(detail::OutputBase& out, const CompiledFormat& fmt, std::size_t count,
+                    const T*... columns) {
+    static_assert(sizeof...(T) > 0, "format_columns needs at least one column");
+    typedef detail::ColumnSource<T...> Source;
+    Source source = { std::tuple<const T*...>(columns...) };
+    detail::RecordPlan<Source>(fmt).run(out, source, 0, count);
+}
+
+} // namespace Vita
+
+#endif // VITA_BATCH_HPP
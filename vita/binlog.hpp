@@ -0,0 +1,456 @@
+// vita/binlog.hpp - deferred binary logging
+//
+// Usage:
+//   Vita::BinlogWriter log(file);                          // FILE* opened "wb"
+//   VITA_BINLOG(log, "order {} filled at {:.2f}", id, price);
+//
+//   // later, offline (or tools/vita_decode)
+//   Vita::BinlogReader reader(data, size);
+//   Vita::detail::FormatOutput line;
+//   std::uint64_t ns;
+//   while (reader.next(line, ns)) { ... line.shrink(line.size()); }
+//
+// Each VITA_BINLOG call site registers its format string once (a function
+// local static) and gets a process-wide id. Events are stored as the id, a
+// timestamp and the raw arguments tagged with their type; nothing
+// is formatted until the stream is decoded. A format string is written to
+// the stream the first time a writer uses its id, so streams decode without
+// the binary that produced them.
+//
+// Stream layout: "VITABIN1", then records
+//   'D' id fmt_len fmt                      format definition
+//   'E' id ts_delta nargs (tag payload)*    event
+// Integers are LEB128 varints (signed ones zigzag encoded), the timestamp
+// is the signed delta in nanoseconds from the previous event, doubles and
+// long doubles are stored as raw native bytes, strings as length + bytes
+// (length + 1 for C strings, 0 meaning null). Argument tags are the
+// BinlogTag values below and never change with FormatArg.
+// Streams are decoded on a machine with the same long double layout.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_BINLOG_HPP
+#define VITA_BINLOG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "format.hpp"
+
+namespace Vita {
+namespace detail {
+
+struct BinlogRegistry {
+    std::mutex mutex;
+    std::vector<const char*> formats;
+};
+
+inline BinlogRegistry& binlog_registry() {
+    static BinlogRegistry registry;
+    return registry;
+}
+
+inline std::uint32_t binlog_register(const char* fmt) {
+    BinlogRegistry& r = binlog_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.formats.push_back(fmt);
+    return static_cast<std::uint32_t>(r.formats.size() - 1);
+}
+
+inline const char* binlog_format(std::uint32_t id) {
+    BinlogRegistry& r = binlog_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return id < r.formats.size() ? r.formats[id] : 0;
+}
+
+static const char binlog_magic[8] = { 'V', 'I', 'T', 'A', 'B', 'I', 'N', '1' };
+
+inline void put_varint(OutputBase& out, unsigned long long v) {
+    char buf[10];
+    std::size_t n = 0;
+    while (v >= 0x80) {
+        buf[n++] = static_cast<char>((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = static_cast<char>(v);
+    out.append(buf, n);
+}
+
+inline void put_svarint(OutputBase& out, long long v) {
+    unsigned long long u = static_cast<unsigned long long>(v);
+    put_varint(out, (u << 1) ^ (v < 0 ? ~0ULL : 0ULL));
+}
+
+// on-disk argument tags; never renumber, only add
+enum BinlogTag {
+    BINLOG_NONE = 0,
+    BINLOG_BOOL = 1,
+    BINLOG_CHAR = 2,
+    BINLOG_INT = 3,
+    BINLOG_UINT = 4,
+    BINLOG_LLONG = 5,
+    BINLOG_ULLONG = 6,
+    BINLOG_DOUBLE = 7,
+    BINLOG_LDOUBLE = 8,
+    BINLOG_CSTRING = 9,
+    BINLOG_STRING = 10,
+    BINLOG_POINTER = 12
+};
+
+inline BinlogTag binlog_tag(FormatArg::Type type) {
+    switch (type) {
+    case FormatArg::BOOL: return BINLOG_BOOL;
+    case FormatArg::CHAR: return BINLOG_CHAR;
+    case FormatArg::INT: return BINLOG_INT;
+    case FormatArg::UINT: return BINLOG_UINT;
+    case FormatArg::LLONG: return BINLOG_LLONG;
+    case FormatArg::ULLONG: return BINLOG_ULLONG;
+    case FormatArg::DOUBLE: return BINLOG_DOUBLE;
+    case FormatArg::LDOUBLE: return BINLOG_LDOUBLE;
+    case FormatArg::CSTRING: return BINLOG_CSTRING;
+    case FormatArg::STRING:
+    case FormatArg::STRING_VIEW: return BINLOG_STRING;
+    case FormatArg::POINTER: return BINLOG_POINTER;
+    case FormatArg::NONE:
+    case FormatArg::CUSTOM: return BINLOG_NONE;
+    }
+    return BINLOG_NONE;
+}
+
+inline void put_arg(OutputBase& out, const FormatArg& arg) {
+    out.append(static_cast<char>(binlog_tag(arg.type())));
+    switch (arg.type()) {
+    case FormatArg::BOOL:
+        out.append(arg.as_bool() ? '\1' : '\0');
+        break;
+    case FormatArg::CHAR:
+        out.append(arg.as_char());
+        break;
+    case FormatArg::INT:
+        put_svarint(out, arg.as_int());
+        break;
+    case FormatArg::UINT:
+        put_varint(out, arg.as_uint());
+        break;
+    case FormatArg::LLONG:
+        put_svarint(out, arg.as_llong());
+        break;
+    case FormatArg::ULLONG:
+        put_varint(out, arg.as_ullong());
+        break;
+    case FormatArg::DOUBLE: {
+        double d = arg.as_double();
+        out.append(reinterpret_cast<const char*>(&d), sizeof(d));
+        break;
+    }
+    case FormatArg::LDOUBLE: {
+        long double d = arg.as_ldouble();
+        out.append(reinterpret_cast<const char*>(&d), sizeof(d));
+        break;
+    }
+    case FormatArg::CSTRING: {
+        // length + 1, zero for a null pointer so it still renders as "(null)"
+        const char* s = arg.as_cstring();
+        std::size_t len = s ? std::strlen(s) : 0;
+        put_varint(out, s ? len + 1 : 0);
+        out.append(s, len);
+        break;
+    }
+    case FormatArg::STRING:
+        put_varint(out, arg.as_string()->size());
+        out.append(arg.as_string()->data(), arg.as_string()->size());
+        break;
+    case FormatArg::STRING_VIEW:
+        put_varint(out, arg.as_view().size);
+        out.append(arg.as_view().data, arg.as_view().size);
+        break;
+    case FormatArg::POINTER:
+        put_varint(out, reinterpret_cast<std::uintptr_t>(arg.as_pointer()));
+        break;
+    case FormatArg::NONE:
+    case FormatArg::CUSTOM:
+        break;
+    }
+}
+
+inline std::uint64_t binlog_now() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+} // namespace detail
+
+// thread-safe; buffers events and writes them to the FILE* in blocks;
+// write errors set failed()
+class BinlogWriter {
+public:
+    explicit BinlogWriter(std::FILE* f, std::size_t buffer_size = 64 * 1024)
+        : file_(f), buffer_size_(buffer_size), last_ts_(0), failed_(false)
+    {
+        buf_.append(detail::binlog_magic, sizeof(detail::binlog_magic));
+    }
+
+    ~BinlogWriter() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        write_out();
+        flush_file();
+    }
+
+    BinlogWriter(const BinlogWriter&) = delete;
+    BinlogWriter& operator=(const BinlogWriter&) = delete;
+
+    // id comes from the VITA_BINLOG call site
+    template <typename... Args>
+    void write(std::uint32_t id, Args&&... args) {
+        detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+        detail::pack_args(arg_array, std::forward<Args>(args)...);
+        std::uint64_t ts = detail::binlog_now();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (id >= defined_.size() || !defined_[id]) define(id);
+
+        buf_.append('E');
+        detail::put_varint(buf_, id);
+        detail::put_svarint(buf_, static_cast<long long>(ts - last_ts_));
+        last_ts_ = ts;
+        buf_.append(static_cast<char>(sizeof...(Args)));
+        for (std::size_t i = 0; i < sizeof...(Args); ++i)
+            detail::put_arg(buf_, arg_array[i]);
+
+        if (buf_.size() >= buffer_size_) write_out();
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        write_out();
+        flush_file();
+    }
+
+    // a write to the FILE* failed; records from then on may be lost
+    bool failed() const { return failed_.load(std::memory_order_relaxed); }
+
+private:
+    void define(std::uint32_t id) {
+        const char* fmt = detail::binlog_format(id);
+        std::size_t len = fmt ? std::strlen(fmt) : 0;
+        buf_.append('D');
+        detail::put_varint(buf_, id);
+        detail::put_varint(buf_, len);
+        buf_.append(fmt, len);
+        if (id >= defined_.size()) defined_.resize(id + 1, false);
+        defined_[id] = true;
+    }
+
+    void write_out() {
+        if (buf_.size() == 0) return;
+        if (std::fwrite(buf_.data(), 1, buf_.size(), file_) != buf_.size() || std::ferror(file_))
+            failed_.store(true, std::memory_order_relaxed);
+        buf_.shrink(buf_.size());
+    }
+
+    void flush_file() {
+        if (std::fflush(file_) != 0 || std::ferror(file_))
+            failed_.store(true, std::memory_order_relaxed);
+    }
+
+    std::FILE* file_;
+    std::size_t buffer_size_;
+    std::mutex mutex_;
+    detail::FormatOutput buf_;
+    std::vector<bool> defined_;
+    std::uint64_t last_ts_;
+    std::atomic<bool> failed_;
+};
+
+// decodes a complete stream held in memory
+class BinlogReader {
+public:
+    BinlogReader(const char* data, std::size_t len)
+        : p_(data), end_(data + len), ts_(0), error_(false)
+    {
+        if (len < sizeof(detail::binlog_magic) ||
+            std::memcmp(data, detail::binlog_magic, sizeof(detail::binlog_magic)) != 0) {
+            error_ = true;
+            p_ = end_;
+        } else {
+            p_ += sizeof(detail::binlog_magic);
+        }
+    }
+
+    // appends the next event's text to out; false at the end or on bad input
+    bool next(detail::OutputBase& out, std::uint64_t& timestamp) {
+        while (p_ < end_) {
+            char tag = *p_++;
+            if (tag == 'D') {
+                if (!read_definition()) return fail();
+                continue;
+            }
+            if (tag != 'E') return fail();
+
+            unsigned long long id;
+            long long delta;
+            if (!get_varint(id) || !get_svarint(delta) || p_ >= end_) return fail();
+            if (id >= formats_.size() || !formats_[id].data) return fail();
+            std::size_t nargs = static_cast<unsigned char>(*p_++);
+            if (nargs > VITA_FORMAT_MAX_ARGS) return fail();
+
+            detail::FormatArg args[VITA_FORMAT_MAX_ARGS];
+            for (std::size_t i = 0; i < nargs; ++i)
+                if (!get_arg(args[i])) return fail();
+
+            ts_ += static_cast<std::uint64_t>(delta);
+            timestamp = ts_;
+            const detail::FormatArg::StringView& fmt = formats_[id];
+            detail::format_to_impl(out, fmt.data, fmt.size, args, nargs);
+            return true;
+        }
+        return false;
+    }
+
+    bool error() const { return error_; }
+
+private:
+    bool fail() {
+        error_ = true;
+        p_ = end_;
+        return false;
+    }
+
+    bool get_varint(unsigned long long& v) {
+        v = 0;
+        for (int shift = 0; shift < 64 && p_ < end_; shift += 7) {
+            unsigned char b = static_cast<unsigned char>(*p_++);
+            v |= static_cast<unsigned long long>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool get_svarint(long long& v) {
+        unsigned long long u;
+        if (!get_varint(u)) return false;
+        v = static_cast<long long>(u >> 1) ^ -static_cast<long long>(u & 1);
+        return true;
+    }
+
+    bool get_bytes(const char*& s, std::size_t& len) {
+        unsigned long long n;
+        if (!get_varint(n) || n > static_cast<unsigned long long>(end_ - p_)) return false;
+        s = p_;
+        len = static_cast<std::size_t>(n);
+        p_ += len;
+        return true;
+    }
+
+    template <typename T>
+    bool get_raw(T& v) {
+        if (static_cast<std::size_t>(end_ - p_) < sizeof(T)) return false;
+        std::memcpy(&v, p_, sizeof(T));
+        p_ += sizeof(T);
+        return true;
+    }
+
+    bool read_definition() {
+        unsigned long long id;
+        const char* s;
+        std::size_t len;
+        if (!get_varint(id) || id > 0xFFFFFFFFULL || !get_bytes(s, len)) return false;
+        if (id >= formats_.size()) {
+            detail::FormatArg::StringView none = { 0, 0 };
+            formats_.resize(static_cast<std::size_t>(id) + 1, none);
+        }
+        formats_[id].data = s;
+        formats_[id].size = len;
+        return true;
+    }
+
+    bool get_arg(detail::FormatArg& arg) {
+        if (p_ >= end_) return false;
+        unsigned long long u;
+        long long i;
+        switch (static_cast<unsigned char>(*p_++)) {
+        case detail::BINLOG_BOOL:
+            if (p_ >= end_) return false;
+            arg = detail::FormatArg(*p_++ != 0);
+            return true;
+        case detail::BINLOG_CHAR:
+            if (p_ >= end_) return false;
+            arg = detail::FormatArg(*p_++);
+            return true;
+        case detail::BINLOG_INT:
+            if (!get_svarint(i)) return false;
+            arg = detail::FormatArg(static_cast<int>(i));
+            return true;
+        case detail::BINLOG_UINT:
+            if (!get_varint(u)) return false;
+            arg = detail::FormatArg(static_cast<unsigned int>(u));
+            return true;
+        case detail::BINLOG_LLONG:
+            if (!get_svarint(i)) return false;
+            arg = detail::FormatArg(i);
+            return true;
+        case detail::BINLOG_ULLONG:
+            if (!get_varint(u)) return false;
+            arg = detail::FormatArg(u);
+            return true;
+        case detail::BINLOG_DOUBLE: {
+            double d;
+            if (!get_raw(d)) return false;
+            arg = detail::FormatArg(d);
+            return true;
+        }
+        case detail::BINLOG_LDOUBLE: {
+            long double d;
+            if (!get_raw(d)) return false;
+            arg = detail::FormatArg(d);
+            return true;
+        }
+        case detail::BINLOG_CSTRING: {
+            if (!get_varint(u) || u > static_cast<unsigned long long>(end_ - p_) + 1) return false;
+            if (u == 0) {
+                arg = detail::FormatArg(static_cast<const char*>(0));
+                return true;
+            }
+            arg = detail::FormatArg(p_, static_cast<std::size_t>(u - 1));
+            p_ += u - 1;
+            return true;
+        }
+        case detail::BINLOG_STRING: {
+            const char* s;
+            std::size_t len;
+            if (!get_bytes(s, len)) return false;
+            arg = detail::FormatArg(s, len);
+            return true;
+        }
+        case detail::BINLOG_POINTER:
+            if (!get_varint(u)) return false;
+            arg = detail::FormatArg(reinterpret_cast<const void*>(static_cast<std::uintptr_t>(u)));
+            return true;
+        case detail::BINLOG_NONE:
+            arg = detail::FormatArg();
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    const char* p_;
+    const char* end_;
+    std::uint64_t ts_;
+    bool error_;
+    std::vector<detail::FormatArg::StringView> formats_;
+};
+
+} // namespace Vita
+
+// registers fmt once per call site, then records the arguments unformatted
+#define VITA_BINLOG(writer, fmt, ...)                                                 \
+    do {                                                                              \
+        static const std::uint32_t vita_binlog_id_ = ::Vita::detail::binlog_register(fmt); \
+        (writer).write(vita_binlog_id_, ##__VA_ARGS__);                               \
+    } while (0)
+
+#endif // VITA_BINLOG_HPP
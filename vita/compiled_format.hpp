@@ -0,0 +1,168 @@
+// vita/compiled_format.hpp - format strings parsed once and reused
+//
+// Usage:
+//   static const Vita::CompiledFormat row("{},{},{:.6f}\n");
+//   Vita::format_to(out, row, id, name, score);
+//   std::string line = Vita::format(row, id, name, score);
+//
+// CompiledFormat parses its format string when it is constructed and keeps
+// the literal text and the placeholder specs, so formatting with it skips
+// the parser. It owns a copy of the string and may outlive it. An invalid
+// format string throws std::runtime_error from the constructor (or, with
+// VITA_FORMAT_NO_EXCEPTIONS, formats as "{error}"). Results of format()
+// are reserved from the sizes of earlier results, as with VITA_FORMAT.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_COMPILED_FORMAT_HPP
+#define VITA_COMPILED_FORMAT_HPP
+
+#include <vector>
+
+#include "format.hpp"
+
+namespace Vita {
+
+namespace detail {
+
+struct CompiledSegment {
+    int arg_index;               // -1 for literal text
+    std::size_t begin;           // literal text in CompiledFormat::text_
+    std::size_t length;
+    FormatSpec spec;
+};
+
+} // namespace detail
+
+class CompiledFormat {
+public:
+    explicit CompiledFormat(const char* fmt) { compile(fmt, std::strlen(fmt)); }
+    explicit CompiledFormat(const std::string& fmt) { compile(fmt.data(), fmt.size()); }
+
+    CompiledFormat(const CompiledFormat& other)
+        : text_(other.text_), segments_(other.segments_), num_args_(other.num_args_) {
+        hint_.size.store(other.hint_.size.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    CompiledFormat& operator=(const CompiledFormat& other) {
+        text_ = other.text_;
+        segments_ = other.segments_;
+        num_args_ = other.num_args_;
+        hint_.size.store(other.hint_.size.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    // arguments the format refers to (highest index + 1)
+    std::size_t arg_count() const noexcept { return num_args_; }
+
+    const std::vector<detail::CompiledSegment>& segments() const noexcept { return segments_; }
+    const char* text() const noexcept { return text_.data(); }
+
+    detail::SizeHint& size_hint() const noexcept { return hint_; }
+
+private:
+    void compile(const char* fmt, std::size_t len) {
+        hint_.size.store(0, std::memory_order_relaxed);
+        num_args_ = 0;
+        detail::FormatParser parser(fmt, len);
+        for (;;) {
+            detail::ParseSegment seg = parser.next();
+            switch (seg.type) {
+            case detail::ParseSegment::LITERAL:
+                add_literal(seg.begin, static_cast<std::size_t>(seg.end - seg.begin));
+                break;
+
+            case detail::ParseSegment::PLACEHOLDER: {
+                detail::CompiledSegment c;
+                c.arg_index = seg.placeholder.arg_index;
+                c.begin = 0;
+                c.length = 0;
+                c.spec = seg.placeholder.spec;
+                segments_.push_back(c);
+                if (c.arg_index >= 0 && static_cast<std::size_t>(c.arg_index) >= num_args_)
+                    num_args_ = static_cast<std::size_t>(c.arg_index) + 1;
+                break;
+            }
+
+            case detail::ParseSegment::ESCAPE_OPEN:
+                add_literal("{", 1);
+                break;
+
+            case detail::ParseSegment::ESCAPE_CLOSE:
+                add_literal("}", 1);
+                break;
+
+            case detail::ParseSegment::END:
+                return;
+
+            case detail::ParseSegment::ERROR:
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+                throw std::runtime_error("Vita::CompiledFormat: invalid format string");
+#else
+                add_literal("{error}", 7);
+                break;
+#endif
+            }
+        }
+    }
+
+    // adjacent literals and escapes share one segment
+    void add_literal(const char* s, std::size_t len) {
+        if (len == 0) return;
+        if (!segments_.empty() && segments_.back().arg_index < 0) {
+            segments_.back().length += len;
+        } else {
+            detail::CompiledSegment c;
+            c.arg_index = -1;
+            c.begin = text_.size();
+            c.length = len;
+            segments_.push_back(c);
+        }
+        text_.append(s, len);
+    }
+
+    std::string text_;
+    std::vector<detail::CompiledSegment> segments_;
+    std::size_t num_args_;
+    mutable detail::SizeHint hint_;
+};
+
+namespace detail {
+
+inline void format_compiled_impl(OutputBase& out, const CompiledFormat& fmt,
+                                 const FormatArg* args, std::size_t num_args) {
+    const char* text = fmt.text();
+    const std::vector<CompiledSegment>& segments = fmt.segments();
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+        const CompiledSegment& seg = segments[i];
+        if (seg.arg_index < 0)
+            out.append(text + seg.begin, seg.length);
+        else if (static_cast<std::size_t>(seg.arg_index) < num_args)
+            format_arg(out, args[seg.arg_index], seg.spec);
+        else
+            out.append("{?}", 3);
+    }
+}
+
+} // namespace detail
+
+template <typename... Args>
+void format_to(detail::OutputBase& out, const CompiledFormat& fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    detail::format_compiled_impl(out, fmt, arg_array, sizeof...(Args));
+}
+
+template <typename... Args>
+std::string format(const CompiledFormat& fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    const detail::FormatArg* a = arg_array;
+    return detail::format_hinted(fmt.size_hint(), [&fmt, a](detail::OutputBase& out) {
+        detail::format_compiled_impl(out, fmt, a, sizeof...(Args));
+    });
+}
+
+} // namespace Vita
+
+#endif // VITA_COMPILED_FORMAT_HPP
@@ -0,0 +1,275 @@
+// vita/csv_writer.hpp - columnar CSV export
+//
+// Usage:
+//   Vita::CsvWriter csv;
+//   csv.column("id", ids)              // std::vector<std::int64_t>
+//      .column("name", names)          // std::vector<std::string>
+//      .column("score", scores, 6);    // std::vector<double>, 6 decimals
+//   csv.write([](const char* data, std::size_t len) {
+//       std::fwrite(data, 1, len, out);
+//   });
+//
+// CsvWriter takes whole columns instead of rows. The table is cut into
+// tiles of tile_rows rows; within a tile each column is encoded on its own
+// by a loop that only knows that column's type (integers, floating point
+// or strings, the last checked for characters that need quoting with the
+// vectorised csv scan), and the encoded cells are then interleaved into
+// rows. Tiles are encoded on several threads and reach the sink in order,
+// through the same scheduler as format_batch. Columns are referenced, not
+// copied, and must stay valid while writing.
+//
+// Fields are quoted as in RFC 4180 when they contain the delimiter (a comma
+// by default, a tab for TSV), a quote or a line break. Floating point
+// columns use the shortest presentation ({}) unless a precision of at most
+// 17 is given ({:.Nf}).
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_CSV_WRITER_HPP
+#define VITA_CSV_WRITER_HPP
+
+#include <cstdlib>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "batch.hpp"
+
+namespace Vita {
+
+struct CsvOptions {
+    bool header;                 // write the column names as the first row
+    std::size_t tile_rows;       // rows encoded together, sized to stay in cache
+    unsigned threads;            // encoding threads, 0 = hardware concurrency
+    char delimiter;              // field separator, '\t' for TSV
+
+    CsvOptions() : header(true), tile_rows(2048), threads(0), delimiter(',') {}
+};
+
+namespace detail {
+
+// one encoded column of a tile: the cells back to back, and where each ends
+struct CsvCells {
+    FormatOutput text;
+    std::vector<std::size_t> ends;
+};
+
+struct CsvColumn;
+typedef void (*CsvEncodeFn)(const CsvColumn& col, CsvCells& cells, std::size_t begin, std::size_t end);
+
+struct CsvColumn {
+    std::string name;
+    const void* data;
+    int precision;
+    char delimiter;
+    CsvEncodeFn encode;
+};
+
+// longest cell an integer or floating point column can produce; fixed
+// notation switches to exponents for large values, so this is bounded
+inline std::size_t csv_number_bound(int precision) {
+    if (precision < 0) return 24;
+    std::size_t digits = static_cast<std::size_t>(precision) + 1;
+    std::size_t fixed = 17 + (digits > 20 ? digits : 20);
+    return fixed > 24 ? fixed : 24;
+}
+
+template <typename T>
+inline std::size_t csv_int_to_str(T value, char* buffer, std::true_type) { return int_to_str(value, buffer); }
+
+template <typename T>
+inline std::size_t csv_int_to_str(T value, char* buffer, std::false_type) { return uint_to_str(value, buffer); }
+
+template <typename T>
+void csv_encode_int(const CsvColumn& col, CsvCells& cells, std::size_t begin, std::size_t end) {
+    const T* v = static_cast<const T*>(col.data);
+    std::size_t bound = (end - begin) * 24;
+    char* base = cells.text.grow(bound);
+    char* p = base;
+    for (std::size_t i = begin; i < end; ++i) {
+        p += csv_int_to_str(v[i], p, std::is_signed<T>());
+        cells.ends[i - begin] = static_cast<std::size_t>(p - base);
+    }
+    cells.text.shrink(bound - static_cast<std::size_t>(p - base));
+}
+
+template <typename T>
+void csv_encode_float(const CsvColumn& col, CsvCells& cells, std::size_t begin, std::size_t end) {
+    const T* v = static_cast<const T*>(col.data);
+    std::size_t bound = (end - begin) * csv_number_bound(col.precision);
+    char* base = cells.text.grow(bound);
+    char* p = base;
+    if (col.precision < 0) {
+        for (std::size_t i = begin; i < end; ++i) {
+            p += double_to_str_shortest(static_cast<double>(v[i]), p);
+            cells.ends[i - begin] = static_cast<std::size_t>(p - base);
+        }
+    } else {
+        for (std::size_t i = begin; i < end; ++i) {
+            p += double_to_str_fixed(static_cast<double>(v[i]), p, col.precision);
+            cells.ends[i - begin] = static_cast<std::size_t>(p - base);
+        }
+    }
+    cells.text.shrink(bound - static_cast<std::size_t>(p - base));
+}
+
+inline void csv_encode_string(const CsvColumn& col, CsvCells& cells, std::size_t begin, std::size_t end) {
+    const std::string* v = static_cast<const std::string*>(col.data);
+    for (std::size_t i = begin; i < end; ++i) {
+        append_csv_field(cells.text, v[i].data(), v[i].size(), col.delimiter);
+        cells.ends[i - begin] = cells.text.size();
+    }
+}
+
+inline void csv_encode_cstring(const CsvColumn& col, CsvCells& cells, std::size_t begin, std::size_t end) {
+    const char* const* v = static_cast<const char* const*>(col.data);
+    for (std::size_t i = begin; i < end; ++i) {
+        if (v[i]) append_csv_field(cells.text, v[i], std::strlen(v[i]), col.delimiter);
+        cells.ends[i - begin] = cells.text.size();
+    }
+}
+
+template <typename T, bool Float = std::is_floating_point<T>::value>
+struct CsvEncoder {
+    static CsvEncodeFn get() { return &csv_encode_int<T>; }
+};
+
+template <typename T>
+struct CsvEncoder<T, true> {
+    static CsvEncodeFn get() { return &csv_encode_float<T>; }
+};
+
+} // namespace detail
+
+class CsvWriter {
+public:
+    explicit CsvWriter(const CsvOptions& options = CsvOptions()) : options_(options), rows_(0) {}
+
+    // integer or floating point column; precision applies to floating point
+    // and is at most 17. char and bool have no column type of their own
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value &&
+                            !std::is_same<T, char>::value, CsvWriter&>::type
+    column(const std::string& name, const T* data, std::size_t rows, int precision = -1) {
+        return add(name, data, rows, precision, detail::CsvEncoder<T>::get());
+    }
+
+    CsvWriter& column(const std::string& name, const std::string* data, std::size_t rows) {
+        return add(name, data, rows, -1, &detail::csv_encode_string);
+    }
+
+    // null pointers are written as empty fields
+    CsvWriter& column(const std::string& name, const char* const* data, std::size_t rows) {
+        return add(name, data, rows, -1, &detail::csv_encode_cstring);
+    }
+
+    template <typename T, typename A>
+    CsvWriter& column(const std::string& name, const std::vector<T, A>& data) {
+        return column(name, data.data(), data.size());
+    }
+
+    template <typename T, typename A>
+    CsvWriter& column(const std::string& name, const std::vector<T, A>& data, int precision) {
+        return column(name, data.data(), data.size(), precision);
+    }
+
+    std::size_t rows() const noexcept { return rows_; }
+    std::size_t columns() const noexcept { return columns_.size(); }
+
+    // pass the table to sink(const char*, std::size_t), tile by tile in order
+    template <typename Sink>
+    void write(Sink sink) const {
+        if (columns_.empty()) return;
+        if (options_.header) {
+            FormatOutput head;
+            for (std::size_t c = 0; c < columns_.size(); ++c) {
+                if (c) head.append(options_.delimiter);
+                detail::append_csv_field(head, columns_[c].name.data(), columns_[c].name.size(),
+                                         options_.delimiter);
+            }
+            head.append('\n');
+            sink(head.data(), head.size());
+        }
+
+        BatchOptions batch;
+        batch.threads = options_.threads;
+        batch.chunk_records = options_.tile_rows;
+        detail::run_batch(rows_, batch, &CsvWriter::encode_tile, this,
+                          &detail::call_batch_sink<Sink>, &sink);
+    }
+
+    std::string str() const {
+        std::string result;
+        write([&result](const char* data, std::size_t len) { result.append(data, len); });
+        return result;
+    }
+
+private:
+    typedef detail::FormatOutput FormatOutput;
+
+    CsvWriter& add(const std::string& name, const void* data, std::size_t rows, int precision,
+                   detail::CsvEncodeFn encode) {
+        if (!columns_.empty() && rows != rows_)
+            fail("Vita::CsvWriter: column '" + name + "' has a different number of rows");
+        if (precision > 17)
+            fail("Vita::CsvWriter: column '" + name + "' has a precision above 17");
+        detail::CsvColumn col;
+        col.name = name;
+        col.data = data;
+        col.precision = precision;
+        col.delimiter = options_.delimiter;
+        col.encode = encode;
+        columns_.push_back(col);
+        rows_ = rows;
+        return *this;
+    }
+
+    // encode each column of rows [begin, end), then interleave them into rows
+    static void encode_tile(const void* job, detail::OutputBase& out, std::size_t begin, std::size_t end) {
+        const CsvWriter& self = *static_cast<const CsvWriter*>(job);
+        std::size_t n = end - begin;
+        std::size_t ncols = self.columns_.size();
+        char delim = self.options_.delimiter;
+
+        // per-thread cells; keep their capacity from tile to tile
+        static thread_local std::vector<detail::CsvCells> cells;
+        if (cells.size() < ncols) cells.resize(ncols);
+
+        std::size_t total = n * ncols;
+        for (std::size_t c = 0; c < ncols; ++c) {
+            cells[c].text.shrink(cells[c].text.size());
+            cells[c].ends.resize(n);
+            self.columns_[c].encode(self.columns_[c], cells[c], begin, end);
+            total += cells[c].text.size();
+        }
+
+        char* dst = out.grow(total);
+        for (std::size_t r = 0; r < n; ++r) {
+            for (std::size_t c = 0; c < ncols; ++c) {
+                const detail::CsvCells& col = cells[c];
+                std::size_t from = r ? col.ends[r - 1] : 0;
+                std::size_t len = col.ends[r] - from;
+                std::memcpy(dst, col.text.data() + from, len);
+                dst += len;
+                *dst++ = c + 1 < ncols ? delim : '\n';
+            }
+        }
+    }
+
+    static void fail(const std::string& msg) {
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+        throw std::runtime_error(msg);
+#else
+        (void)msg;
+        std::abort();
+#endif
+    }
+
+    CsvOptions options_;
+    std::size_t rows_;
+    std::vector<detail::CsvColumn> columns_;
+};
+
+} // namespace Vita
+
+#endif // VITA_CSV_WRITER_HPP
@@ -3,6 +3,8 @@
 
 #include <cstddef>
 
+#include "utf8_lead.hpp"
+
 #if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
 #define VITA_FORMAT_ENSURE_FSTRING_AVAILABLE_ 1
 #else
@@ -29,15 +31,21 @@ constexpr bool is_type(char c) {
     return c == 'd' || c == 'x' || c == 'X' || c == 'o' || c == 'b'
         || c == 'f' || c == 'F' || c == 'e' || c == 'E'
         || c == 's' || c == 'c' || c == 'p'
-        || c == 'g' || c == 'G' || c == 'a' || c == 'A';
+        || c == 'g' || c == 'G' || c == 'a' || c == 'A'
+        || c == '?' || c == 'j' || c == 'h' || c == 'q' || c == 'u';
+}
+
+// same lengths as the runtime parser, so both accept the same fills
+constexpr std::size_t fill_len(char c) {
+    return utf8_seq_len(static_cast<unsigned char>(c));
 }
 
 constexpr int parse_format_spec(const char* s, std::size_t n, std::size_t& i) {
     if (i >= n || s[i] == '}') {
         return 0;
     }
-    if (i + 1 < n && is_align(s[i + 1])) {
-        i += 2;
+    if (i + fill_len(s[i]) < n && is_align(s[i + fill_len(s[i])])) {
+        i += fill_len(s[i]) + 1;
     } else if (is_align(s[i])) {
         i += 1;
     }
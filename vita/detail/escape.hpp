@@ -0,0 +1,304 @@
+// vita/detail/escape.hpp
+// escaped string presentations: '?' (debug), 'j' (json), 'h' (html), 'q' (csv),
+// plus logfmt value quoting
+#ifndef VITA_DETAIL_ESCAPE_HPP
+#define VITA_DETAIL_ESCAPE_HPP
+
+#include <cstddef>
+#include <cstring>
+
+#include "output.hpp"
+#include "int_to_str.hpp"
+#include "simd.hpp"
+
+namespace Vita {
+namespace detail {
+
+enum EscapeMode { ESCAPE_DEBUG, ESCAPE_JSON, ESCAPE_HTML, ESCAPE_CSV, ESCAPE_LOGFMT };
+
+inline bool is_escape_type(char type) {
+    return type == '?' || type == 'j' || type == 'h' || type == 'q';
+}
+
+inline EscapeMode escape_mode(char type) {
+    switch (type) {
+    case 'j': return ESCAPE_JSON;
+    case 'h': return ESCAPE_HTML;
+    case 'q': return ESCAPE_CSV;
+    default:  return ESCAPE_DEBUG;
+    }
+}
+
+template <EscapeMode M>
+inline bool needs_escape(unsigned char c) {
+    switch (M) {
+    case ESCAPE_DEBUG: return c < 0x20 || c == 0x7F || c == '"' || c == '\\';
+    case ESCAPE_JSON:  return c < 0x20 || c == '"' || c == '\\';
+    case ESCAPE_HTML:  return c == '&' || c == '<' || c == '>' || c == '"' || c == '\'';
+    case ESCAPE_CSV:   return c == ',' || c == '"' || c == '\n' || c == '\r';
+    case ESCAPE_LOGFMT: return c <= 0x20 || c == 0x7F || c == '=' || c == '"';
+    }
+    return false;
+}
+
+#if VITA_FORMAT_SSE2
+template <EscapeMode M>
+inline unsigned escape_mask16(__m128i v) {
+    __m128i m;
+    if (M == ESCAPE_DEBUG || M == ESCAPE_JSON) {
+        // unsigned c <= 0x1F  <=>  min(c, 0x1F) == c
+        m = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+        if (M == ESCAPE_DEBUG)
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+    } else if (M == ESCAPE_HTML) {
+        m = _mm_cmpeq_epi8(v, _mm_set1_epi8('&'));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('<')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('>')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+    } else if (M == ESCAPE_LOGFMT) {
+        m = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x20)), v);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('=')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    } else {
+        m = _mm_cmpeq_epi8(v, _mm_set1_epi8(','));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    }
+    return static_cast<unsigned>(_mm_movemask_epi8(m));
+}
+#endif
+
+#if VITA_FORMAT_AVX2
+template <EscapeMode M>
+inline unsigned escape_mask32(__m256i v) {
+    __m256i m;
+    if (M == ESCAPE_DEBUG || M == ESCAPE_JSON) {
+        m = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+        if (M == ESCAPE_DEBUG)
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F)));
+    } else if (M == ESCAPE_HTML) {
+        m = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('&'));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('<')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('>')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+    } else if (M == ESCAPE_LOGFMT) {
+        m = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x20)), v);
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F)));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('=')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+    } else {
+        m = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+    }
+    return static_cast<unsigned>(_mm256_movemask_epi8(m));
+}
+#endif
+
+// offset of the first byte that needs escaping, or len if the run is clean
+template <EscapeMode M>
+inline std::size_t find_escape(const char* s, std::size_t len) {
+    std::size_t i = 0;
+
+#if VITA_FORMAT_AVX2
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        unsigned mask = escape_mask32<M>(v);
+        if (mask) return i + lowest_bit(mask);
+    }
+#endif
+
+#if VITA_FORMAT_SSE2
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        unsigned mask = escape_mask16<M>(v);
+        if (mask) return i + lowest_bit(mask);
+    }
+#endif
+
+    for (; i < len; ++i) {
+        if (needs_escape<M>(static_cast<unsigned char>(s[i]))) return i;
+    }
+    return len;
+}
+
+inline std::size_t find_escape(const char* s, std::size_t len, EscapeMode mode) {
+    switch (mode) {
+    case ESCAPE_DEBUG: return find_escape<ESCAPE_DEBUG>(s, len);
+    case ESCAPE_JSON:  return find_escape<ESCAPE_JSON>(s, len);
+    case ESCAPE_HTML:  return find_escape<ESCAPE_HTML>(s, len);
+    case ESCAPE_CSV:   return find_escape<ESCAPE_CSV>(s, len);
+    case ESCAPE_LOGFMT: return find_escape<ESCAPE_LOGFMT>(s, len);
+    }
+    return len;
+}
+
+inline void append_hex_escape(OutputBase& out, const char* prefix, std::size_t prefix_len,
+                              unsigned char c) {
+    const char* hex = hex_digits_lower();
+    out.append(prefix, prefix_len);
+    out.append(hex[c >> 4]);
+    out.append(hex[c & 0xF]);
+}
+
+inline void append_escape_seq(OutputBase& out, unsigned char c, EscapeMode mode) {
+    if (mode == ESCAPE_HTML) {
+        switch (c) {
+        case '&':  out.append("&amp;", 5); return;
+        case '<':  out.append("&lt;", 4); return;
+        case '>':  out.append("&gt;", 4); return;
+        case '"':  out.append("&quot;", 6); return;
+        default:   out.append("&#39;", 5); return;
+        }
+    }
+
+    switch (c) {
+    case '"':  out.append("\\\"", 2); return;
+    case '\\': out.append("\\\\", 2); return;
+    case '\n': out.append("\\n", 2); return;
+    case '\r': out.append("\\r", 2); return;
+    case '\t': out.append("\\t", 2); return;
+    case '\b': out.append("\\b", 2); return;
+    case '\f': out.append("\\f", 2); return;
+    }
+
+    if (mode == ESCAPE_JSON)
+        append_hex_escape(out, "\\u00", 4, c);
+    else
+        append_hex_escape(out, "\\x", 2, c);
+}
+
+// offset of the first byte that forces a csv field separated by delim to
+// be quoted, or len
+inline std::size_t find_csv_special(const char* s, std::size_t len, char delim) {
+    if (delim == ',') return find_escape<ESCAPE_CSV>(s, len);
+    std::size_t i = 0;
+
+#if VITA_FORMAT_SSE2
+    const __m128i d = _mm_set1_epi8(delim);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i m = _mm_cmpeq_epi8(v, d);
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(m));
+        if (mask) return i + lowest_bit(mask);
+    }
+#endif
+
+    for (; i < len; ++i) {
+        char c = s[i];
+        if (c == delim || c == '"' || c == '\n' || c == '\r') return i;
+    }
+    return len;
+}
+
+// csv fields are quoted only when they contain the separator, a quote or a
+// newline; embedded quotes are doubled
+inline void append_csv_field(OutputBase& out, const char* s, std::size_t len, char delim = ',') {
+    std::size_t pos = find_csv_special(s, len, delim);
+    if (pos == len) {
+        out.append(s, len);
+        return;
+    }
+
+    out.append('"');
+    const char* p = s;
+    const char* end = s + len;
+    for (;;) {
+        const char* q = static_cast<const char*>(std::memchr(p, '"', static_cast<std::size_t>(end - p)));
+        if (!q) break;
+        out.append(p, static_cast<std::size_t>(q - p) + 1);
+        out.append('"');
+        p = q + 1;
+    }
+    out.append(p, static_cast<std::size_t>(end - p));
+    out.append('"');
+}
+
+template <EscapeMode M>
+inline void append_escaped_body(OutputBase& out, const char* s, std::size_t len);
+
+// logfmt values stay bare unless empty or holding spaces, '=', quotes or
+// control bytes; quoted values use json escapes
+inline void append_logfmt_value(OutputBase& out, const char* s, std::size_t len) {
+    std::size_t pos = find_escape<ESCAPE_LOGFMT>(s, len);
+    if (pos == len && len != 0) {
+        out.append(s, len);
+        return;
+    }
+
+    // bytes before pos may still need json escapes, such as a backslash
+    out.append('"');
+    append_escaped_body<ESCAPE_JSON>(out, s, len);
+    out.append('"');
+}
+
+template <EscapeMode M>
+inline void append_escaped_body(OutputBase& out, const char* s, std::size_t len) {
+    const char* p = s;
+    const char* end = s + len;
+    for (;;) {
+        std::size_t run = find_escape<M>(p, static_cast<std::size_t>(end - p));
+        out.append(p, run);
+        p += run;
+        if (p == end) return;
+        append_escape_seq(out, static_cast<unsigned char>(*p++), M);
+    }
+}
+
+// copy s into out escaped for mode; debug strings are wrapped in double quotes
+inline void append_escaped(OutputBase& out, const char* s, std::size_t len, EscapeMode mode) {
+    switch (mode) {
+    case ESCAPE_DEBUG:
+        out.append('"');
+        append_escaped_body<ESCAPE_DEBUG>(out, s, len);
+        out.append('"');
+        break;
+    case ESCAPE_JSON:
+        append_escaped_body<ESCAPE_JSON>(out, s, len);
+        break;
+    case ESCAPE_HTML:
+        append_escaped_body<ESCAPE_HTML>(out, s, len);
+        break;
+    case ESCAPE_CSV:
+        append_csv_field(out, s, len);
+        break;
+    case ESCAPE_LOGFMT:
+        append_logfmt_value(out, s, len);
+        break;
+    }
+}
+
+// debug presentation of a single char: '\'' quoted, like a C character literal
+inline void append_escaped_char(OutputBase& out, char c, EscapeMode mode) {
+    if (mode != ESCAPE_DEBUG) {
+        append_escaped(out, &c, 1, mode);
+        return;
+    }
+    out.append('\'');
+    if (c == '\'')
+        out.append("\\'", 2);
+    else if (c == '"')
+        out.append('"');
+    else if (needs_escape<ESCAPE_DEBUG>(static_cast<unsigned char>(c)))
+        append_escape_seq(out, static_cast<unsigned char>(c), ESCAPE_DEBUG);
+    else
+        out.append(c);
+    out.append('\'');
+}
+
+} // namespace detail
+} // namespace Vita
+
+#endif
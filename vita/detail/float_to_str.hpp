@@ -103,6 +103,7 @@ inline std::size_t double_to_str_shortest(double value, char* buffer, int precis
 
     double norm = abs_val;
     if (exp10 > 0) norm = abs_val / pow10_fast(exp10);
+    else if (exp10 < -300) norm = abs_val * 1e300 * pow10_fast(-exp10 - 300); // subnormals: 10^324 overflows
     else if (exp10 < 0) norm = abs_val * pow10_fast(-exp10);
 
     while (norm >= 10.0) { norm /= 10.0; exp10++; }
@@ -224,7 +225,8 @@ inline std::size_t double_to_str_scientific(double value, char* buffer, int prec
 
     double abs_val = c.negative ? -value : value;
     int exp10 = estimate_exp10(abs_val);
-    double norm = abs_val / pow10_fast(exp10);
+    double norm = exp10 < -300 ? abs_val * 1e300 / pow10_fast(exp10 + 300)
+                               : abs_val / pow10_fast(exp10);
 
     while (norm >= 10.0) { norm /= 10.0; exp10++; }
     while (norm < 1.0) { norm *= 10.0; exp10--; }
@@ -0,0 +1,243 @@
+// vita/detail/io_uring.hpp
+// minimal io_uring ring on raw syscalls, for the async file sink
+#ifndef VITA_DETAIL_IO_URING_HPP
+#define VITA_DETAIL_IO_URING_HPP
+
+#if defined(VITA_FORMAT_TESTING)
+#include <atomic>
+#endif
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define VITA_FORMAT_HAS_IO_URING 1
+#endif
+#endif
+
+#if VITA_FORMAT_HAS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace Vita {
+namespace detail {
+
+#if VITA_FORMAT_HAS_IO_URING
+
+#if defined(VITA_FORMAT_TESTING)
+// errno that IoRing::submit reports after entering the kernel, 0 for none;
+// lets tests exercise the fallback when a ring breaks with writes in flight
+inline std::atomic<int>& io_ring_fault() {
+    static std::atomic<int> fault(0);
+    return fault;
+}
+#endif
+
+// one submission and one completion queue, used by a single thread; the
+// kernel shares the ring indices, so they are read and written with
+// acquire/release ordering
+class IoRing {
+public:
+    IoRing()
+        : fd_(-1), sq_ptr_(0), cq_ptr_(0), sqes_(0), sq_size_(0), cq_size_(0),
+          sqes_size_(0), entries_(0), unsubmitted_(0) {}
+
+    ~IoRing() { close(); }
+
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    // false where io_uring is missing or not permitted
+    bool open(unsigned entries) {
+        struct io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+        if (fd < 0) return false;
+        fd_ = fd;
+
+        sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single && cq_size_ > sq_size_) sq_size_ = cq_size_;
+
+        sq_ptr_ = map(sq_size_, IORING_OFF_SQ_RING);
+        if (!sq_ptr_) return fail();
+        if (single) {
+            cq_ptr_ = sq_ptr_;
+        } else {
+            cq_ptr_ = map(cq_size_, IORING_OFF_CQ_RING);
+            if (!cq_ptr_) return fail();
+        }
+        sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes_ = static_cast<struct io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+        if (!sqes_) return fail();
+
+        char* sq = static_cast<char*>(sq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+
+        char* cq = static_cast<char*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+
+        entries_ = p.sq_entries;
+        return true;
+    }
+
+    void close() {
+        if (sqes_) ::munmap(sqes_, sqes_size_);
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) ::munmap(cq_ptr_, cq_size_);
+        if (sq_ptr_) ::munmap(sq_ptr_, sq_size_);
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        sq_ptr_ = cq_ptr_ = 0;
+        sqes_ = 0;
+    }
+
+    // pin the buffers for IORING_OP_WRITE_FIXED
+    bool register_buffers(const struct iovec* iov, unsigned count) {
+        return ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, iov, count) == 0;
+    }
+
+    unsigned entries() const noexcept { return entries_; }
+
+    // queue a write without entering the kernel; false if the queue is full
+    bool write_fixed(int fd, const char* data, unsigned len, std::uint64_t offset,
+                     unsigned buf_index, std::uint64_t user_data) {
+        struct io_uring_sqe* sqe = next_sqe();
+        if (!sqe) return false;
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(data);
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->buf_index = static_cast<std::uint16_t>(buf_index);
+        sqe->user_data = user_data;
+        push_sqe();
+        return true;
+    }
+
+    // iov must stay valid until submit() has returned
+    bool writev(int fd, const struct iovec* iov, std::uint64_t offset, std::uint64_t user_data) {
+        struct io_uring_sqe* sqe = next_sqe();
+        if (!sqe) return false;
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(iov);
+        sqe->len = 1;
+        sqe->off = offset;
+        sqe->user_data = user_data;
+        push_sqe();
+        return true;
+    }
+
+    // submit everything queued in one system call and wait for at least
+    // wait_for completions; negative errno on failure
+    int submit(unsigned wait_for) {
+        for (;;) {
+            long r = ::syscall(__NR_io_uring_enter, fd_, unsubmitted_, wait_for,
+                               wait_for ? IORING_ENTER_GETEVENTS : 0, static_cast<void*>(0), 0);
+            if (r >= 0) {
+                unsubmitted_ -= static_cast<unsigned>(r);
+#if defined(VITA_FORMAT_TESTING)
+                if (int fault = io_ring_fault().load(std::memory_order_relaxed)) return -fault;
+#endif
+                return static_cast<int>(r);
+            }
+            if (errno != EINTR) return -errno;
+        }
+    }
+
+    // wait for a completion without submitting anything; negative errno
+    // on failure
+    int wait() {
+        long r = ::syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS,
+                           static_cast<void*>(0), 0);
+        return r < 0 ? -errno : 0;
+    }
+
+    // user_data of queued writes the kernel has not taken yet; these never
+    // run once the ring is closed
+    std::size_t unconsumed(std::uint64_t* user_data, std::size_t max) const {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        unsigned tail = *sq_tail_;
+        std::size_t n = 0;
+        for (; head != tail && n < max; ++head)
+            user_data[n++] = sqes_[sq_array_[head & sq_mask_]].user_data;
+        return n;
+    }
+
+    // take the next completion, if there is one
+    bool complete(std::uint64_t& user_data, int& result) {
+        unsigned head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) return false;
+        const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        user_data = cqe.user_data;
+        result = cqe.res;
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    void* map(std::size_t size, std::uint64_t offset) {
+        void* p = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                         static_cast<off_t>(offset));
+        return p == MAP_FAILED ? 0 : p;
+    }
+
+    bool fail() {
+        close();
+        return false;
+    }
+
+    struct io_uring_sqe* next_sqe() {
+        unsigned tail = *sq_tail_;
+        if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= entries_) return 0;
+        struct io_uring_sqe* sqe = &sqes_[tail & sq_mask_];
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    void push_sqe() {
+        unsigned tail = *sq_tail_;
+        sq_array_[tail & sq_mask_] = tail & sq_mask_;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        ++unsubmitted_;
+    }
+
+    int fd_;
+    void* sq_ptr_;
+    void* cq_ptr_;
+    struct io_uring_sqe* sqes_;
+    std::size_t sq_size_;
+    std::size_t cq_size_;
+    std::size_t sqes_size_;
+    unsigned entries_;
+    unsigned unsubmitted_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe* cqes_;
+};
+
+#endif // VITA_FORMAT_HAS_IO_URING
+
+} // namespace detail
+} // namespace Vita
+
+#endif
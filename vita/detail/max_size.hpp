@@ -0,0 +1,191 @@
+// vita/detail/max_size.hpp
+// compile-time upper bound on the formatted length (C++14)
+#ifndef VITA_DETAIL_MAX_SIZE_HPP
+#define VITA_DETAIL_MAX_SIZE_HPP
+
+#include <cstddef>
+#include <type_traits>
+
+#include "utf8_lead.hpp"
+
+#if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+#define VITA_FORMAT_HAS_MAX_SIZE 1
+
+namespace Vita { namespace detail { namespace maxsz {
+
+// argument classes with a worst-case length; strings have none
+enum Kind { UNBOUNDED, BOOL, CHAR, INT32, UINT32, INT64, UINT64, FLOAT, POINTER };
+
+static constexpr std::size_t NO_BOUND = static_cast<std::size_t>(-1);
+
+template <typename... T>
+struct TypeList {};
+
+// unevaluated only: the decayed argument types of a call
+template <typename... T>
+TypeList<typename std::decay<T>::type...> arg_types(T&&...);
+
+template <typename T>
+constexpr Kind kind_of() {
+    return std::is_same<T, bool>::value ? BOOL
+         : std::is_same<T, char>::value ? CHAR
+         : std::is_floating_point<T>::value ? FLOAT
+         : std::is_same<T, std::nullptr_t>::value ? POINTER
+         : std::is_pointer<T>::value
+               ? (std::is_same<typename std::remove_cv<typename std::remove_pointer<T>::type>::type, char>::value
+                      ? UNBOUNDED : POINTER)
+         : std::is_enum<T>::value ? INT64
+         : !std::is_integral<T>::value ? UNBOUNDED
+         : sizeof(T) <= sizeof(int) ? (std::is_signed<T>::value ? INT32 : UINT32)
+         : (std::is_signed<T>::value ? INT64 : UINT64);
+}
+
+struct Spec {
+    std::size_t fill_len;
+    std::size_t width;
+    int precision;
+    char type;
+};
+
+constexpr bool is_align(char c) {
+    return c == '<' || c == '>' || c == '^' || c == '=';
+}
+
+constexpr bool is_type(char c) {
+    return c == 'd' || c == 'x' || c == 'X' || c == 'o' || c == 'b' ||
+           c == 'f' || c == 'F' || c == 'e' || c == 'E' || c == 'g' || c == 'G' ||
+           c == 's' || c == 'c' || c == 'p' || c == 'a' || c == 'A' ||
+           c == '?' || c == 'j' || c == 'h' || c == 'q' || c == 'u';
+}
+
+// parse from after ':' up to the closing '}', as parse_format_spec does
+// over the same range; anything after the type is ignored
+constexpr Spec parse_spec(const char* s, std::size_t n, std::size_t& i) {
+    Spec spec = { 1, 0, -1, '\0' };
+    std::size_t e = i;
+    while (e < n && s[e] != '}') ++e;
+    std::size_t fill = i < e ? utf8_seq_len(static_cast<unsigned char>(s[i])) : 1;
+    if (i < e && i + fill < e && is_align(s[i + fill])) {
+        spec.fill_len = fill;
+        i += fill + 1;
+    } else if (i < n && is_align(s[i])) {
+        ++i;
+    }
+    if (i < e && (s[i] == '+' || s[i] == '-' || s[i] == ' ')) ++i;
+    if (i < e && s[i] == '#') ++i;
+    if (i < e && s[i] == '0') ++i;
+    while (i < e && s[i] >= '0' && s[i] <= '9')
+        spec.width = spec.width * 10 + static_cast<std::size_t>(s[i++] - '0');
+    if (i < e && s[i] == '.') {
+        ++i;
+        spec.precision = 0;
+        while (i < e && s[i] >= '0' && s[i] <= '9')
+            spec.precision = spec.precision * 10 + (s[i++] - '0');
+    }
+    if (i < e && is_type(s[i])) spec.type = s[i];
+    i = e;
+    return spec;
+}
+
+constexpr std::size_t max_of(std::size_t a, std::size_t b) { return a > b ? a : b; }
+
+// hex keeps the '-' of negative values; decimal may gain a '+' or ' '
+constexpr std::size_t int_bound(char type, std::size_t bits, std::size_t digits, bool is_signed) {
+    return type == 'b' ? bits
+         : type == 'o' ? (bits + 2) / 3
+         : type == 'x' || type == 'X' ? bits / 4 + (is_signed ? 1 : 0)
+         : digits + 1;
+}
+
+// worst case of format_arg before padding; mirrors float_to_str
+constexpr std::size_t content_bound(Kind kind, const Spec& spec) {
+    switch (kind) {
+    case BOOL:    return spec.type == 'd' ? 1 : 5;
+    case CHAR:    return 8; // '\u0001' or 0b11111111
+    case INT32:   return int_bound(spec.type, 32, 10, true);
+    case UINT32:  return int_bound(spec.type, 32, 10, false);
+    case INT64:   return int_bound(spec.type, 64, 19, true);
+    case UINT64:  return int_bound(spec.type, 64, 20, false);
+    case POINTER: return 18;
+    case FLOAT: {
+        std::size_t prec = spec.precision >= 0 ? static_cast<std::size_t>(spec.precision) : 6;
+        if (spec.type == 'f' || spec.type == 'F')
+            return max_of(17 + max_of(prec + 1, 20), 24);
+        if (spec.type == 'e' || spec.type == 'E')
+            return prec + 8;
+        return 24;
+    }
+    default:      return NO_BOUND;
+    }
+}
+
+template <std::size_t N>
+constexpr std::size_t bound(const char* s, std::size_t n, const Kind (&kinds)[N], std::size_t num_args) {
+    std::size_t total = 0;
+    std::size_t next_arg = 0;
+    std::size_t i = 0;
+    while (i < n) {
+        if (s[i] == '{' && i + 1 < n && s[i + 1] == '{') {
+            ++total;
+            i += 2;
+        } else if (s[i] == '}' && i + 1 < n && s[i + 1] == '}') {
+            ++total;
+            i += 2;
+        } else if (s[i] == '{') {
+            ++i;
+            std::size_t idx = next_arg;
+            if (i < n && s[i] >= '0' && s[i] <= '9') {
+                idx = 0;
+                while (i < n && s[i] >= '0' && s[i] <= '9')
+                    idx = idx * 10 + static_cast<std::size_t>(s[i++] - '0');
+            } else {
+                ++next_arg;
+            }
+            Spec spec = { 1, 0, -1, '\0' };
+            if (i < n && s[i] == ':') {
+                ++i;
+                spec = parse_spec(s, n, i);
+            }
+            if (i >= n || s[i] != '}') return NO_BOUND;
+            ++i;
+
+            std::size_t len = 3; // "{?}"
+            if (idx < num_args) {
+                len = content_bound(kinds[idx], spec);
+                if (len == NO_BOUND) return NO_BOUND;
+                len = max_of(len, spec.width * spec.fill_len);
+            }
+            total += len;
+        } else {
+            ++total;
+            ++i;
+        }
+    }
+    return total;
+}
+
+template <typename List>
+struct Bound;
+
+template <typename... T>
+struct Bound<TypeList<T...> > {
+    template <std::size_t N>
+    static constexpr std::size_t of(const char (&fmt)[N]) {
+        const Kind kinds[sizeof...(T) > 0 ? sizeof...(T) : 1] = { kind_of<T>()... };
+        return bound(fmt, N - 1, kinds, sizeof...(T));
+    }
+};
+
+template <std::size_t Size>
+struct SizedCheck {
+    static_assert(Size != NO_BOUND,
+        "Vita::max_formatted_size: a string or other unbounded argument, "
+        "or an unclosed '{', leaves the output without a maximum size");
+    static constexpr std::size_t value = Size;
+};
+
+}}} // namespace Vita::detail::maxsz
+
+#endif
+
+#endif
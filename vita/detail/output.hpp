@@ -7,41 +7,101 @@
 #include <cstring>
 #include <string>
 
+#include "pool.hpp"
+
+// smaller inline output buffers, for fibers and coroutines with small stacks
+#ifndef VITA_FORMAT_SMALL_STACK
+#define VITA_FORMAT_SMALL_STACK 0
+#endif
+
 #ifndef VITA_FORMAT_SBO_SIZE
+#if VITA_FORMAT_SMALL_STACK
+#define VITA_FORMAT_SBO_SIZE 64
+#else
 #define VITA_FORMAT_SBO_SIZE 256
 #endif
+#endif
+
+// count heap use by outputs per thread (Vita::alloc_stats)
+#ifndef VITA_FORMAT_ALLOC_STATS
+#define VITA_FORMAT_ALLOC_STATS 0
+#endif
+
+// recycle output heap blocks through a size-classed pool (Vita::pool_stats)
+#ifndef VITA_FORMAT_POOL
+#define VITA_FORMAT_POOL 0
+#endif
 
 namespace Vita {
+
+// global-heap use by Vita on the calling thread, including the std::string
+// results of format; memory from a caller's allocator is not counted
+struct AllocStats {
+    std::size_t allocations;  // blocks allocated
+    std::size_t bytes;        // bytes in those blocks
+    std::size_t growths;      // allocations that moved output already written
+};
+
 namespace detail {
 
-class FormatOutput {
-public:
-    FormatOutput() noexcept
-        : size_(0), capacity_(VITA_FORMAT_SBO_SIZE),
-          data_(sbo_), heap_(false) {}
+inline AllocStats& thread_alloc_stats() {
+    static thread_local AllocStats stats = { 0, 0, 0 };
+    return stats;
+}
 
-    ~FormatOutput() {
-        if (heap_) delete[] data_;
-    }
+inline void note_alloc(std::size_t bytes, bool growth) {
+#if VITA_FORMAT_ALLOC_STATS
+    AllocStats& stats = thread_alloc_stats();
+    ++stats.allocations;
+    stats.bytes += bytes;
+    if (growth) ++stats.growths;
+#else
+    (void)bytes;
+    (void)growth;
+#endif
+}
 
-    FormatOutput(const FormatOutput&) = delete;
-    FormatOutput& operator=(const FormatOutput&) = delete;
+// heap blocks for outputs; cap may be rounded up to the pool's block size
+inline char* heap_allocate(std::size_t& cap, bool growth) {
+#if VITA_FORMAT_POOL
+    if (char* p = pool_allocate(cap)) return p;
+#endif
+    note_alloc(cap, growth);
+    return new char[cap];
+}
 
-    FormatOutput(FormatOutput&& other) noexcept
-        : size_(other.size_), capacity_(other.capacity_), heap_(other.heap_)
-    {
-        if (other.heap_) {
-            data_ = other.data_;
-            other.data_ = other.sbo_;
-            other.heap_ = false;
-        } else {
-            std::memcpy(sbo_, other.sbo_, other.size_);
-            data_ = sbo_;
-        }
-        other.size_ = 0;
-        other.capacity_ = VITA_FORMAT_SBO_SIZE;
+inline void heap_free(char* p, std::size_t cap) {
+#if VITA_FORMAT_POOL
+    pool_free(p, cap);
+#else
+    (void)cap;
+    delete[] p;
+#endif
+}
+
+} // namespace detail
+
+// all zero unless VITA_FORMAT_ALLOC_STATS is 1
+inline AllocStats alloc_stats() { return detail::thread_alloc_stats(); }
+
+inline void reset_alloc_stats() {
+    AllocStats zero = { 0, 0, 0 };
+    detail::thread_alloc_stats() = zero;
+}
+
+namespace detail {
+
+// the output logic; storage comes from the derived class. functions that
+// write output take an OutputBase& so any inline capacity can be used
+class OutputBase {
+public:
+    ~OutputBase() {
+        if (heap_) heap_free(data_, capacity_);
     }
 
+    OutputBase(const OutputBase&) = delete;
+    OutputBase& operator=(const OutputBase&) = delete;
+
     void append(char c) {
         ensure(1);
         data_[size_++] = c;
@@ -49,7 +109,13 @@ public:
 
     void append(const char* s, std::size_t len) {
         if (len == 0) return;
-        ensure(len);
+        if (size_ + len > capacity_) {
+            if (bounded_) {
+                append_chunked(s, len);
+                return;
+            }
+            ensure(len);
+        }
         std::memcpy(data_ + size_, s, len);
         size_ += len;
     }
@@ -60,14 +126,47 @@ public:
 
     void append_fill(char c, std::size_t n) {
         if (n == 0) return;
+        while (bounded_ && size_ + n > capacity_) {
+            std::size_t k = size_ < capacity_ ? capacity_ - size_ : 0;
+            if (k) {
+                std::memset(data_ + size_, c, k);
+                size_ += k;
+                n -= k;
+            }
+            ensure(1);
+        }
         ensure(n);
         std::memset(data_ + size_, c, n);
         size_ += n;
     }
 
-    void reserve(std::size_t n) { ensure(n); }
+    // n copies of a multi-byte fill sequence
+    void append_fill(const char* seq, std::size_t seq_len, std::size_t n) {
+        if (seq_len == 1) {
+            append_fill(*seq, n);
+            return;
+        }
+        if (n == 0) return;
+        if (bounded_ && size_ + seq_len * n > capacity_) {
+            for (std::size_t i = 0; i < n; ++i)
+                append(seq, seq_len);
+            return;
+        }
+        ensure(seq_len * n);
+        char* p = data_ + size_;
+        for (std::size_t i = 0; i < n; ++i, p += seq_len)
+            std::memcpy(p, seq, seq_len);
+        size_ += seq_len * n;
+    }
+
+    void reserve(std::size_t n) {
+        if (!bounded_) ensure(n);
+    }
 
     std::string finish() {
+#if VITA_FORMAT_ALLOC_STATS
+        if (size_ > std::string().capacity()) note_alloc(size_ + 1, false);
+#endif
         std::string result(data_, size_);
         size_ = 0;
         return result;
@@ -82,33 +181,148 @@ public:
 
     void shrink(std::size_t n) { size_ -= n; }
 
+    // hand over the heap buffer (free it with heap_free(p, capacity)) and
+    // leave the output empty; null while the contents still fit the small buffer
+    char* release(std::size_t& capacity) noexcept {
+        if (!heap_) return 0;
+        char* p = data_;
+        capacity = capacity_;
+        data_ = inline_;
+        capacity_ = inline_cap_;
+        heap_ = false;
+        size_ = 0;
+        return p;
+    }
+
     std::size_t size() const noexcept { return size_; }
+    std::size_t capacity() const noexcept { return capacity_; }
+
+    // bytes written, including those a bounded output has handed off
+    std::size_t written() const noexcept { return handed_off_ + size_; }
+
+    // bounded outputs may hand off written bytes when full, so data()
+    // only covers what was written since the last hand-off
+    bool bounded() const noexcept { return bounded_; }
     const char* data() const noexcept { return data_; }
 
+protected:
+    // called with the required total size when the buffer is full; must
+    // install a buffer of at least that capacity through set_buffer
+    typedef void (*GrowFn)(OutputBase& out, std::size_t need);
+
+    // output into caller-managed storage, grown by the hook, or by the
+    // heap when there is none; release() returns to buf
+    OutputBase(char* buf, std::size_t capacity, GrowFn grow) noexcept
+        : size_(0), capacity_(capacity), data_(buf), inline_(buf), inline_cap_(capacity),
+          heap_(false), bounded_(false), grow_(grow), handed_off_(0) {}
+
+    // take the contents of other, whose inline storage is no larger than ours
+    void take(OutputBase& other) noexcept {
+        size_ = other.size_;
+        if (other.heap_) {
+            data_ = other.data_;
+            capacity_ = other.capacity_;
+            heap_ = true;
+            other.data_ = other.inline_;
+            other.heap_ = false;
+        } else {
+            std::memcpy(data_, other.data_, other.size_);
+        }
+        other.size_ = 0;
+        other.capacity_ = other.inline_cap_;
+    }
+
+    // the first size() bytes of buf must hold the current contents
+    void set_buffer(char* buf, std::size_t capacity) noexcept {
+        data_ = buf;
+        capacity_ = capacity;
+    }
+
+    // the hook empties the window rather than enlarging it; appends and
+    // fills larger than the window are split into window-sized pieces and
+    // only ask the hook for room for one more byte
+    void set_bounded(bool b) noexcept { bounded_ = b; }
+
+    // the window's contents were passed on; empty it
+    void window_handed_off() noexcept {
+        handed_off_ += size_;
+        size_ = 0;
+    }
+
+    // start over with nothing written
+    void restart() noexcept {
+        handed_off_ = 0;
+        size_ = 0;
+    }
+
 private:
+    void append_chunked(const char* s, std::size_t len) {
+        while (len > 0) {
+            if (size_ == capacity_) ensure(1);
+            std::size_t k = capacity_ - size_;
+            if (k > len) k = len;
+            std::memcpy(data_ + size_, s, k);
+            size_ += k;
+            s += k;
+            len -= k;
+        }
+    }
+
     void ensure(std::size_t extra) {
         std::size_t need = size_ + extra;
         if (need <= capacity_) return;
+        if (grow_) {
+            grow_(*this, need);
+            return;
+        }
 
         std::size_t cap = capacity_ + capacity_ / 2;
         if (cap < need) cap = need;
 
-        char* buf = new char[cap];
+        char* buf = heap_allocate(cap, size_ > 0);
         std::memcpy(buf, data_, size_);
-        if (heap_) delete[] data_;
+        if (heap_) heap_free(data_, capacity_);
 
         data_ = buf;
         capacity_ = cap;
         heap_ = true;
     }
 
-    char sbo_[VITA_FORMAT_SBO_SIZE];
     std::size_t size_;
     std::size_t capacity_;
     char* data_;
+    char* inline_;
+    std::size_t inline_cap_;
     bool heap_;
+    bool bounded_;
+    GrowFn grow_;
+    std::size_t handed_off_;
 };
 
+// an output with N bytes of inline storage before it moves to the heap
+template <std::size_t N>
+class InlineOutput : public OutputBase {
+    static_assert(N > 0, "Vita::InlineOutput - inline capacity must be positive");
+
+public:
+    InlineOutput() noexcept : OutputBase(inline_, N, 0) {}
+
+    InlineOutput(InlineOutput&& other) noexcept : OutputBase(inline_, N, 0) { take(other); }
+
+protected:
+    // for outputs that supply their own storage or grow hook
+    InlineOutput(char* buf, std::size_t capacity, GrowFn grow) noexcept
+        : OutputBase(buf, capacity, grow) {}
+
+    // the inline storage, unused by outputs that supply their own
+    char* inline_buffer() noexcept { return inline_; }
+
+private:
+    char inline_[N];
+};
+
+typedef InlineOutput<VITA_FORMAT_SBO_SIZE> FormatOutput;
+
 } // namespace detail
 } // namespace Vita
 
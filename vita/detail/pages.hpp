@@ -0,0 +1,27 @@
+// vita/detail/pages.hpp
+// page size helpers for the POSIX file sinks
+#ifndef VITA_DETAIL_PAGES_HPP
+#define VITA_DETAIL_PAGES_HPP
+
+#include <cstddef>
+
+#include <unistd.h>
+
+namespace Vita {
+namespace detail {
+
+inline std::size_t page_size() {
+    static const std::size_t size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+// n rounded up to a whole number of pages, at least one page
+inline std::size_t round_to_pages(std::size_t n) {
+    std::size_t page = page_size();
+    return n == 0 ? page : (n + page - 1) / page * page;
+}
+
+} // namespace detail
+} // namespace Vita
+
+#endif
@@ -7,37 +7,46 @@
 #include <cstdint>
 #include <cstring>
 
+#include "utf8.hpp"
+
 namespace Vita {
 namespace detail {
 
 struct FormatSpec {
-    char fill;
+    char fill;        // first byte of the fill character
     char align;       // '<' '>' '^' '='
     char sign;        // '+' '-' ' '
     bool alt_form;
     bool zero_pad;
-    int width;
+    int width;        // in code points (display columns with east asian width)
     int precision;
-    char type;        // d x X o b f e E g G s c p
+    char type;        // d x X o b f e E g G s c p ? j h q u
+    unsigned char fill_len;   // utf-8 bytes in the fill character
+    char fill_tail[3];        // continuation bytes of a multi-byte fill
 
     FormatSpec() noexcept
         : fill(' '), align('\0'), sign('-'), alt_form(false),
-          zero_pad(false), width(0), precision(-1), type('\0') {}
+          zero_pad(false), width(0), precision(-1), type('\0'), fill_len(1) {}
 };
 
+inline bool is_align_char(char c) {
+    return c == '<' || c == '>' || c == '^' || c == '=';
+}
+
 // parse format spec after the ':'
 inline const char* parse_format_spec(const char* begin, const char* end, FormatSpec& spec) {
     if (begin >= end) return begin;
     const char* p = begin;
 
-    // fill + align?
-    if (p + 1 < end) {
-        char c2 = p[1];
-        if (c2 == '<' || c2 == '>' || c2 == '^' || c2 == '=') {
-            spec.fill = *p;
-            spec.align = c2;
-            p += 2;
-        }
+    // fill + align? the fill may be a multi-byte utf-8 character
+    std::size_t fill_len = utf8_seq_len(static_cast<unsigned char>(*p));
+    if (p + fill_len < end && is_align_char(p[fill_len])) {
+        spec.fill = *p;
+        spec.fill_len = static_cast<unsigned char>(fill_len);
+        for (std::size_t i = 1; i < fill_len; ++i)
+            spec.fill_tail[i - 1] = p[i];
+        spec.align = p[fill_len];
+        p += fill_len + 1;
     }
 
     // standalone align
@@ -88,7 +97,8 @@ inline const char* parse_format_spec(const char* begin, const char* end, FormatS
         char c = *p;
         if (c == 'd' || c == 'x' || c == 'X' || c == 'o' || c == 'b' ||
             c == 'f' || c == 'F' || c == 'e' || c == 'E' || c == 'g' || c == 'G' ||
-            c == 's' || c == 'c' || c == 'p' || c == 'a' || c == 'A') {
+            c == 's' || c == 'c' || c == 'p' || c == 'a' || c == 'A' ||
+            c == '?' || c == 'j' || c == 'h' || c == 'q' || c == 'u') {
             spec.type = c;
             p++;
         }
@@ -0,0 +1,238 @@
+// vita/detail/pool.hpp
+// size-classed pool for output heap blocks (VITA_FORMAT_POOL)
+#ifndef VITA_DETAIL_POOL_HPP
+#define VITA_DETAIL_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+
+// largest pooled block; larger ones always come from new[]
+#ifndef VITA_FORMAT_POOL_MAX_BLOCK
+#define VITA_FORMAT_POOL_MAX_BLOCK (1u << 20)
+#endif
+
+// blocks per size class a thread keeps before sharing them
+#ifndef VITA_FORMAT_POOL_CACHE
+#define VITA_FORMAT_POOL_CACHE 8
+#endif
+
+namespace Vita {
+
+struct PoolStats {
+    std::size_t hits;         // allocations served by the pool (this thread)
+    std::size_t misses;       // allocations that went to new[] (this thread)
+    std::size_t cached;       // bytes in this thread's cache
+    std::size_t cached_high;  // high-water mark of cached
+    std::size_t shared;       // bytes on the shared lists
+    std::size_t shared_high;  // high-water mark of shared
+};
+
+namespace detail {
+
+constexpr unsigned pool_log2(std::size_t n) {
+    return n <= 1 ? 0 : 1 + pool_log2(n >> 1);
+}
+
+static const unsigned POOL_MIN_SHIFT = 9; // 512 bytes, above the small buffer
+static const unsigned POOL_CLASSES = pool_log2(VITA_FORMAT_POOL_MAX_BLOCK) - POOL_MIN_SHIFT + 1;
+
+struct PoolBlock {
+    PoolBlock* next;
+};
+
+// one lock-free list per class; pushes use a cas loop and takers swap out
+// the whole list, so a block is never popped from under another thread
+struct PoolShared {
+    std::atomic<PoolBlock*> heads[POOL_CLASSES];
+    std::atomic<std::size_t> bytes;
+    std::atomic<std::size_t> high;
+};
+
+inline PoolShared& pool_shared() {
+    static PoolShared shared; // zero-initialised, never destroyed in use
+    return shared;
+}
+
+// round cap up to its class size; false when it is too large to pool
+inline bool pool_class(std::size_t& cap, unsigned& cls) {
+    if (cap > VITA_FORMAT_POOL_MAX_BLOCK) return false;
+    std::size_t size = std::size_t(1) << POOL_MIN_SHIFT;
+    cls = 0;
+    while (size < cap) {
+        size <<= 1;
+        ++cls;
+    }
+    cap = size;
+    return true;
+}
+
+inline void pool_share(unsigned cls, PoolBlock* first, PoolBlock* last, std::size_t bytes) {
+    PoolShared& shared = pool_shared();
+    PoolBlock* old = shared.heads[cls].load(std::memory_order_relaxed);
+    do {
+        last->next = old;
+    } while (!shared.heads[cls].compare_exchange_weak(old, first, std::memory_order_release,
+                                                      std::memory_order_relaxed));
+    std::size_t now = shared.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    std::size_t high = shared.high.load(std::memory_order_relaxed);
+    while (now > high && !shared.high.compare_exchange_weak(high, now, std::memory_order_relaxed)) {
+    }
+}
+
+// the whole shared list of a class, with its length in count
+inline PoolBlock* pool_take_shared(unsigned cls, unsigned& count) {
+    PoolShared& shared = pool_shared();
+    count = 0;
+    if (!shared.heads[cls].load(std::memory_order_relaxed)) return 0;
+    PoolBlock* list = shared.heads[cls].exchange(0, std::memory_order_acquire);
+    for (PoolBlock* b = list; b; b = b->next) ++count;
+    shared.bytes.fetch_sub(count * (std::size_t(1) << (cls + POOL_MIN_SHIFT)), std::memory_order_relaxed);
+    return list;
+}
+
+inline void pool_delete_list(PoolBlock* list) {
+    while (list) {
+        PoolBlock* next = list->next;
+        delete[] reinterpret_cast<char*>(list);
+        list = next;
+    }
+}
+
+struct PoolCache {
+    PoolBlock* heads[POOL_CLASSES];
+    unsigned counts[POOL_CLASSES];
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t cached;
+    std::size_t cached_high;
+
+    PoolCache() : hits(0), misses(0), cached(0), cached_high(0) {
+        for (unsigned i = 0; i < POOL_CLASSES; ++i) {
+            heads[i] = 0;
+            counts[i] = 0;
+        }
+    }
+
+    // a finished thread hands its blocks to the others
+    ~PoolCache() {
+        pool_cache_gone() = true;
+        for (unsigned i = 0; i < POOL_CLASSES; ++i) {
+            if (!heads[i]) continue;
+            PoolBlock* last = heads[i];
+            while (last->next) last = last->next;
+            pool_share(i, heads[i], last, counts[i] * (std::size_t(1) << (i + POOL_MIN_SHIFT)));
+        }
+    }
+
+    // outputs destroyed after the cache during thread exit use the shared lists
+    static bool& pool_cache_gone() {
+        static thread_local bool gone = false;
+        return gone;
+    }
+};
+
+// move up to VITA_FORMAT_POOL_CACHE shared blocks into the cache; the
+// rest go back so other threads can still find them
+inline void pool_refill(PoolCache& cache, unsigned cls, std::size_t size) {
+    unsigned count;
+    PoolBlock* list = pool_take_shared(cls, count);
+    if (!list) return;
+    PoolBlock* last = list;
+    unsigned kept = 1;
+    while (kept < VITA_FORMAT_POOL_CACHE && last->next) {
+        last = last->next;
+        ++kept;
+    }
+    if (PoolBlock* rest = last->next) {
+        PoolBlock* tail = rest;
+        while (tail->next) tail = tail->next;
+        last->next = 0;
+        pool_share(cls, rest, tail, (count - kept) * size);
+    }
+    cache.heads[cls] = list;
+    cache.counts[cls] = kept;
+    cache.cached += kept * size;
+    if (cache.cached > cache.cached_high) cache.cached_high = cache.cached;
+}
+
+inline PoolCache* pool_cache() {
+    if (PoolCache::pool_cache_gone()) return 0;
+    static thread_local PoolCache cache;
+    return &cache;
+}
+
+// a pooled block of at least cap bytes, or null when the caller should use
+// new[]; cap is rounded up to the block size either way
+inline char* pool_allocate(std::size_t& cap) {
+    unsigned cls;
+    if (pool_class(cap, cls)) {
+        PoolCache* cache = pool_cache();
+        if (cache) {
+            if (!cache->heads[cls]) pool_refill(*cache, cls, cap);
+            if (PoolBlock* b = cache->heads[cls]) {
+                cache->heads[cls] = b->next;
+                --cache->counts[cls];
+                cache->cached -= cap;
+                ++cache->hits;
+                return reinterpret_cast<char*>(b);
+            }
+            ++cache->misses;
+        }
+    }
+    return 0;
+}
+
+// p is from pool_allocate or new[]; cap is the size pool_allocate reported
+inline void pool_free(char* p, std::size_t cap) {
+    unsigned cls;
+    if (!pool_class(cap, cls)) {
+        delete[] p;
+        return;
+    }
+    PoolBlock* b = reinterpret_cast<PoolBlock*>(p);
+    PoolCache* cache = pool_cache();
+    if (cache && cache->counts[cls] < VITA_FORMAT_POOL_CACHE) {
+        b->next = cache->heads[cls];
+        cache->heads[cls] = b;
+        ++cache->counts[cls];
+        cache->cached += cap;
+        if (cache->cached > cache->cached_high) cache->cached_high = cache->cached;
+        return;
+    }
+    pool_share(cls, b, b, cap);
+}
+
+} // namespace detail
+
+// free the calling thread's cached blocks and everything on the shared
+// lists; blocks cached by other threads are left alone
+inline void trim_pool() {
+    detail::PoolCache* cache = detail::pool_cache();
+    for (unsigned i = 0; i < detail::POOL_CLASSES; ++i) {
+        if (cache) {
+            detail::pool_delete_list(cache->heads[i]);
+            cache->heads[i] = 0;
+            cache->counts[i] = 0;
+        }
+        unsigned count;
+        detail::pool_delete_list(detail::pool_take_shared(i, count));
+    }
+    if (cache) cache->cached = 0;
+}
+
+inline PoolStats pool_stats() {
+    PoolStats stats = { 0, 0, 0, 0, 0, 0 };
+    if (detail::PoolCache* cache = detail::pool_cache()) {
+        stats.hits = cache->hits;
+        stats.misses = cache->misses;
+        stats.cached = cache->cached;
+        stats.cached_high = cache->cached_high;
+    }
+    stats.shared = detail::pool_shared().bytes.load(std::memory_order_relaxed);
+    stats.shared_high = detail::pool_shared().high.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace Vita
+
+#endif
@@ -0,0 +1,91 @@
+// vita/detail/simd.hpp
+// instruction set detection and small bit helpers for the vectorised scans
+#ifndef VITA_DETAIL_SIMD_HPP
+#define VITA_DETAIL_SIMD_HPP
+
+#ifndef VITA_FORMAT_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VITA_FORMAT_SSE2 1
+#endif
+#if defined(__SSSE3__) || defined(__AVX2__)
+#define VITA_FORMAT_SSSE3 1
+#endif
+#if defined(__AVX2__)
+#define VITA_FORMAT_AVX2 1
+#endif
+#endif
+
+#ifndef VITA_FORMAT_SSE2
+#define VITA_FORMAT_SSE2 0
+#endif
+#ifndef VITA_FORMAT_SSSE3
+#define VITA_FORMAT_SSSE3 0
+#endif
+#ifndef VITA_FORMAT_AVX2
+#define VITA_FORMAT_AVX2 0
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if VITA_FORMAT_AVX2
+#include <immintrin.h>
+#elif VITA_FORMAT_SSSE3
+#include <tmmintrin.h>
+#elif VITA_FORMAT_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace Vita {
+namespace detail {
+
+// index of the lowest set bit, mask must be non-zero
+inline unsigned lowest_bit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return static_cast<unsigned>(idx);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// memcpy through non-temporal stores, for large copies into memory that
+// will not be read back soon
+inline void stream_copy(char* dst, const char* src, std::size_t len) {
+#if VITA_FORMAT_SSE2
+    std::size_t head = (16 - (reinterpret_cast<std::uintptr_t>(dst) & 15)) & 15;
+    if (len < head + 64) {
+        std::memcpy(dst, src, len);
+        return;
+    }
+    std::memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    len -= head;
+    for (; len >= 64; dst += 64, src += 64, len -= 64) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+    }
+    _mm_sfence();
+    std::memcpy(dst, src, len);
+#else
+    std::memcpy(dst, src, len);
+#endif
+}
+
+} // namespace detail
+} // namespace Vita
+
+#endif
@@ -0,0 +1,326 @@
+// vita/detail/utf8.hpp
+// utf-8 helpers: code point counting with an ascii fast path, optional
+// east asian display width, validation and U+FFFD sanitisation
+#ifndef VITA_DETAIL_UTF8_HPP
+#define VITA_DETAIL_UTF8_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "output.hpp"
+#include "simd.hpp"
+#include "utf8_lead.hpp"
+
+#ifndef VITA_FORMAT_EAST_ASIAN_WIDTH
+#define VITA_FORMAT_EAST_ASIAN_WIDTH 0
+#endif
+
+namespace Vita {
+namespace detail {
+
+inline bool is_ascii(const char* s, std::size_t len) {
+    std::size_t i = 0;
+
+#if VITA_FORMAT_AVX2
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        if (_mm256_movemask_epi8(v)) return false;
+    }
+#endif
+
+#if VITA_FORMAT_SSE2
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        if (_mm_movemask_epi8(v)) return false;
+    }
+#endif
+
+    for (; i + 8 <= len; i += 8) {
+        std::uint64_t w;
+        std::memcpy(&w, s + i, 8);
+        if (w & 0x8080808080808080ull) return false;
+    }
+    for (; i < len; ++i) {
+        if (static_cast<unsigned char>(s[i]) & 0x80) return false;
+    }
+    return true;
+}
+
+// decode one code point at p; malformed input yields the single byte
+inline std::uint32_t utf8_decode(const char* p, const char* end, std::size_t& seq) {
+    unsigned char lead = static_cast<unsigned char>(*p);
+    std::size_t n = utf8_seq_len(lead);
+    if (n == 1 || static_cast<std::size_t>(end - p) < n) {
+        seq = 1;
+        return lead;
+    }
+
+    std::uint32_t cp = lead & (0x7F >> n);
+    for (std::size_t i = 1; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(p[i]);
+        if ((c & 0xC0) != 0x80) {
+            seq = 1;
+            return lead;
+        }
+        cp = (cp << 6) | (c & 0x3F);
+    }
+    seq = n;
+    return cp;
+}
+
+// wide and fullwidth ranges from Unicode's EastAsianWidth.txt, coarsened
+inline unsigned code_point_width(std::uint32_t cp, bool east_asian) {
+    if (!east_asian || cp < 0x1100) return 1;
+    return (cp <= 0x115F ||
+            cp == 0x2329 || cp == 0x232A ||
+            (cp >= 0x2E80 && cp <= 0xA4CF && cp != 0x303F) ||
+            (cp >= 0xAC00 && cp <= 0xD7A3) ||
+            (cp >= 0xF900 && cp <= 0xFAFF) ||
+            (cp >= 0xFE10 && cp <= 0xFE19) ||
+            (cp >= 0xFE30 && cp <= 0xFE6F) ||
+            (cp >= 0xFF00 && cp <= 0xFF60) ||
+            (cp >= 0xFFE0 && cp <= 0xFFE6) ||
+            (cp >= 0x1F300 && cp <= 0x1F64F) ||
+            (cp >= 0x1F900 && cp <= 0x1F9FF) ||
+            (cp >= 0x20000 && cp <= 0x2FFFD) ||
+            (cp >= 0x30000 && cp <= 0x3FFFD)) ? 2 : 1;
+}
+
+inline std::size_t utf8_width(const char* s, std::size_t len, bool east_asian) {
+    if (is_ascii(s, len)) return len;
+
+    const char* p = s;
+    const char* end = s + len;
+    std::size_t width = 0;
+    while (p < end) {
+        if (!(static_cast<unsigned char>(*p) & 0x80)) {
+            ++p;
+            ++width;
+            continue;
+        }
+        std::size_t seq;
+        std::uint32_t cp = utf8_decode(p, end, seq);
+        width += code_point_width(cp, east_asian);
+        p += seq;
+    }
+    return width;
+}
+
+// bytes in the longest prefix that fits in max_width columns,
+// never splitting a code point
+inline std::size_t utf8_prefix(const char* s, std::size_t len, std::size_t max_width, bool east_asian) {
+    std::size_t ascii_len = len < max_width ? len : max_width;
+    if (is_ascii(s, ascii_len)) return ascii_len;
+
+    const char* p = s;
+    const char* end = s + len;
+    std::size_t width = 0;
+    while (p < end) {
+        std::size_t seq;
+        std::uint32_t cp = utf8_decode(p, end, seq);
+        unsigned w = code_point_width(cp, east_asian);
+        if (width + w > max_width) break;
+        width += w;
+        p += seq;
+    }
+    return static_cast<std::size_t>(p - s);
+}
+
+inline std::size_t text_width(const char* s, std::size_t len) {
+    return utf8_width(s, len, VITA_FORMAT_EAST_ASIAN_WIDTH != 0);
+}
+
+inline std::size_t text_prefix(const char* s, std::size_t len, std::size_t max_width) {
+    return utf8_prefix(s, len, max_width, VITA_FORMAT_EAST_ASIAN_WIDTH != 0);
+}
+
+enum Utf8Policy { PASSTHROUGH, SANITIZE };
+
+// length of the well-formed sequence at p, or 0 with bad set to the length
+// of its maximal ill-formed subpart (each such subpart becomes one U+FFFD)
+inline std::size_t utf8_sequence(const unsigned char* p, const unsigned char* end, std::size_t& bad) {
+    unsigned char c = p[0];
+    std::size_t n;
+    unsigned char lo = 0x80, hi = 0xBF;   // bounds for the second byte
+
+    if (c < 0x80) return 1;
+    if (c < 0xC2) { bad = 1; return 0; }
+    if (c < 0xE0) n = 2;
+    else if (c < 0xF0) {
+        n = 3;
+        if (c == 0xE0) lo = 0xA0;
+        else if (c == 0xED) hi = 0x9F;
+    } else if (c < 0xF5) {
+        n = 4;
+        if (c == 0xF0) lo = 0x90;
+        else if (c == 0xF4) hi = 0x8F;
+    } else { bad = 1; return 0; }
+
+    std::size_t avail = static_cast<std::size_t>(end - p);
+    for (std::size_t i = 1; i < n; ++i) {
+        if (i >= avail) { bad = i; return 0; }
+        unsigned char b = p[i];
+        bool ok = (i == 1) ? (b >= lo && b <= hi) : ((b & 0xC0) == 0x80);
+        if (!ok) { bad = i; return 0; }
+    }
+    return n;
+}
+
+// bytes in the longest well-formed prefix
+inline std::size_t utf8_valid_prefix(const char* s, std::size_t len) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s);
+    const unsigned char* end = p + len;
+    while (p < end) {
+        std::size_t run = static_cast<std::size_t>(end - p);
+        if (run >= 16 && is_ascii(reinterpret_cast<const char*>(p), 16)) {
+            p += 16;
+            continue;
+        }
+        std::size_t bad;
+        std::size_t n = utf8_sequence(p, end, bad);
+        if (n == 0) break;
+        p += n;
+    }
+    return static_cast<std::size_t>(p - reinterpret_cast<const unsigned char*>(s));
+}
+
+#if VITA_FORMAT_SSSE3
+// lookup-table validation (Keiser & Lemire, "Validating UTF-8 in less than
+// one instruction per byte"); three nibble lookups classify every byte pair
+// and the 3rd/4th continuation bytes are checked with saturating subtracts
+struct Utf8Lookup {
+    enum {
+        TOO_SHORT = 1 << 0, TOO_LONG = 1 << 1, OVERLONG_3 = 1 << 2, TOO_LARGE = 1 << 3,
+        SURROGATE = 1 << 4, OVERLONG_2 = 1 << 5, TOO_LARGE_1000 = 1 << 6,
+        OVERLONG_4 = 1 << 6, TWO_CONTS = 1 << 7,
+        CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS
+    };
+};
+
+inline __m128i utf8_nibble_lookup(__m128i table, __m128i idx) {
+    return _mm_shuffle_epi8(table, idx);
+}
+
+inline __m128i utf8_block_errors(__m128i input, __m128i prev_input) {
+    typedef Utf8Lookup L;
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+
+    const __m128i byte_1_high_tbl = _mm_setr_epi8(
+        L::TOO_LONG, L::TOO_LONG, L::TOO_LONG, L::TOO_LONG,
+        L::TOO_LONG, L::TOO_LONG, L::TOO_LONG, L::TOO_LONG,
+        static_cast<char>(L::TWO_CONTS), static_cast<char>(L::TWO_CONTS),
+        static_cast<char>(L::TWO_CONTS), static_cast<char>(L::TWO_CONTS),
+        L::TOO_SHORT | L::OVERLONG_2,
+        L::TOO_SHORT,
+        L::TOO_SHORT | L::OVERLONG_3 | L::SURROGATE,
+        static_cast<char>(L::TOO_SHORT | L::TOO_LARGE | L::TOO_LARGE_1000 | L::OVERLONG_4));
+    const __m128i byte_1_low_tbl = _mm_setr_epi8(
+        static_cast<char>(L::CARRY | L::OVERLONG_3 | L::OVERLONG_2 | L::OVERLONG_4),
+        static_cast<char>(L::CARRY | L::OVERLONG_2),
+        static_cast<char>(L::CARRY), static_cast<char>(L::CARRY),
+        static_cast<char>(L::CARRY | L::TOO_LARGE),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000 | L::SURROGATE),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000),
+        static_cast<char>(L::CARRY | L::TOO_LARGE | L::TOO_LARGE_1000));
+    const __m128i byte_2_high_tbl = _mm_setr_epi8(
+        L::TOO_SHORT, L::TOO_SHORT, L::TOO_SHORT, L::TOO_SHORT,
+        L::TOO_SHORT, L::TOO_SHORT, L::TOO_SHORT, L::TOO_SHORT,
+        static_cast<char>(L::TOO_LONG | L::OVERLONG_2 | L::TWO_CONTS | L::OVERLONG_3 |
+                          L::TOO_LARGE_1000 | L::OVERLONG_4),
+        static_cast<char>(L::TOO_LONG | L::OVERLONG_2 | L::TWO_CONTS | L::OVERLONG_3 | L::TOO_LARGE),
+        static_cast<char>(L::TOO_LONG | L::OVERLONG_2 | L::TWO_CONTS | L::SURROGATE | L::TOO_LARGE),
+        static_cast<char>(L::TOO_LONG | L::OVERLONG_2 | L::TWO_CONTS | L::SURROGATE | L::TOO_LARGE),
+        L::TOO_SHORT, L::TOO_SHORT, L::TOO_SHORT, L::TOO_SHORT);
+
+    __m128i byte_1_high = utf8_nibble_lookup(byte_1_high_tbl,
+        _mm_and_si128(_mm_srli_epi16(prev1, 4), low_nibble));
+    __m128i byte_1_low = utf8_nibble_lookup(byte_1_low_tbl, _mm_and_si128(prev1, low_nibble));
+    __m128i byte_2_high = utf8_nibble_lookup(byte_2_high_tbl,
+        _mm_and_si128(_mm_srli_epi16(input, 4), low_nibble));
+    __m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+    __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+    __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    __m128i must23_80 = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+    return _mm_xor_si128(must23_80, special);
+}
+
+// non-zero where the block ends inside a multi-byte sequence
+inline __m128i utf8_block_incomplete(__m128i input) {
+    const __m128i max_value = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm_subs_epu8(input, max_value);
+}
+#endif
+
+inline bool utf8_valid(const char* s, std::size_t len) {
+#if VITA_FORMAT_SSSE3
+    __m128i error = _mm_setzero_si128();
+    __m128i prev_input = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+    std::size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        if (_mm_movemask_epi8(input) == 0) {
+            // an ascii block is fine unless the previous one was cut short
+            error = _mm_or_si128(error, prev_incomplete);
+        } else {
+            error = _mm_or_si128(error, utf8_block_errors(input, prev_input));
+            prev_incomplete = utf8_block_incomplete(input);
+        }
+        prev_input = input;
+    }
+
+    // zero padding turns a sequence cut off by the end into an error
+    char tail[16] = {0};
+    std::memcpy(tail, s + i, len - i);
+    __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail));
+    error = _mm_or_si128(error, utf8_block_errors(input, prev_input));
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+#else
+    return utf8_valid_prefix(s, len) == len;
+#endif
+}
+
+// copy s into out, replacing each ill-formed subpart with U+FFFD
+inline void append_utf8_sanitized(OutputBase& out, const char* s, std::size_t len) {
+    if (utf8_valid(s, len)) {
+        out.append(s, len);
+        return;
+    }
+
+    const char* p = s;
+    const char* end = s + len;
+    for (;;) {
+        std::size_t run = utf8_valid_prefix(p, static_cast<std::size_t>(end - p));
+        out.append(p, run);
+        p += run;
+        if (p == end) return;
+
+        std::size_t bad = 1;
+        utf8_sequence(reinterpret_cast<const unsigned char*>(p),
+                      reinterpret_cast<const unsigned char*>(end), bad);
+        out.append("\xEF\xBF\xBD", 3);
+        p += bad;
+    }
+}
+
+} // namespace detail
+} // namespace Vita
+
+#endif
@@ -0,0 +1,20 @@
+// vita/detail/utf8_lead.hpp
+// utf-8 lead byte classification, shared by the runtime parser and the
+// compile-time format string check
+#ifndef VITA_DETAIL_UTF8_LEAD_HPP
+#define VITA_DETAIL_UTF8_LEAD_HPP
+
+#include <cstddef>
+
+namespace Vita {
+namespace detail {
+
+// length of the sequence introduced by a lead byte, 1 for stray bytes
+constexpr std::size_t utf8_seq_len(unsigned char lead) {
+    return lead < 0xC0 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : lead < 0xF8 ? 4 : 1;
+}
+
+} // namespace detail
+} // namespace Vita
+
+#endif
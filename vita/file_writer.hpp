@@ -0,0 +1,390 @@
+// vita/file_writer.hpp - buffered log-file sink with writev batching
+//
+// Usage:
+//   Vita::FileWriterOptions opts;
+//   opts.rotate_size = 256 << 20;           // rotate at 256 MiB
+//   Vita::FileWriter log("app.log", opts);
+//   log.writeln("{} {} latency={}ms", ts, level, ms);
+//
+// Messages are formatted on the calling thread and copied into large
+// page-aligned buffers under a short lock. A background thread hands full
+// buffers to the kernel with writev, flushes partially filled buffers
+// after flush_interval, preallocates the file ahead of the write position
+// and rotates it (app.log -> app.log.1 -> ...) without blocking writers.
+// Writers wait only when max_pending full buffers are still queued.
+//
+// POSIX only; preallocation uses fallocate on Linux and is a no-op elsewhere.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_FILE_WRITER_HPP
+#define VITA_FILE_WRITER_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "format.hpp"
+#include "detail/pages.hpp"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace Vita {
+
+struct FileWriterOptions {
+    std::size_t buffer_size;     // bytes per buffer, rounded up to whole pages
+    std::size_t max_pending;     // full buffers queued before writers wait
+    std::chrono::milliseconds flush_interval;   // partial buffers are flushed after this
+    std::size_t preallocate;     // reserve disk space in steps of this many bytes, 0 = off
+    std::size_t rotate_size;     // rotate once the file reaches this size, 0 = never
+    unsigned max_files;          // rotated files kept as path.1 .. path.N
+
+    FileWriterOptions()
+        : buffer_size(1 << 20), max_pending(8), flush_interval(100),
+          preallocate(0), rotate_size(0), max_files(5) {}
+};
+
+namespace detail {
+
+struct WriteBuffer {
+    char* data;
+    std::size_t size;
+    std::size_t capacity;
+};
+
+inline bool try_alloc_write_buffer(std::size_t capacity, WriteBuffer& b) noexcept {
+    void* p = 0;
+    if (::posix_memalign(&p, page_size(), capacity) != 0) return false;
+    b.data = static_cast<char*>(p);
+    b.size = 0;
+    b.capacity = capacity;
+    return true;
+}
+
+inline WriteBuffer alloc_write_buffer(std::size_t capacity) {
+    WriteBuffer b;
+    if (!try_alloc_write_buffer(capacity, b)) throw std::bad_alloc();
+    return b;
+}
+
+} // namespace detail
+
+class FileWriter {
+public:
+    explicit FileWriter(const std::string& path, const FileWriterOptions& opts = FileWriterOptions())
+        : path_(path), opts_(opts), fd_(-1), queued_(0), written_(0), stop_(false),
+          file_size_(0), allocated_(0), failed_(false), rotations_(0)
+    {
+        opts_.buffer_size = detail::round_to_pages(opts_.buffer_size);
+        if (opts_.max_pending == 0) opts_.max_pending = 1;
+        // the flusher thread never allocates: pending_ and batch_ hold at
+        // most max_pending buffers plus the one queued on destruction, and
+        // free_ keeps at most max_pending
+        pending_.reserve(opts_.max_pending + 1);
+        batch_.reserve(opts_.max_pending + 1);
+        free_.reserve(opts_.max_pending);
+        active_.data = 0;
+        open_file();
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+        try {
+            active_ = detail::alloc_write_buffer(opts_.buffer_size);
+            flusher_ = std::thread(&FileWriter::flusher_loop, this);
+        } catch (...) {
+            std::free(active_.data);
+            close_file();
+            throw;
+        }
+#else
+        active_ = detail::alloc_write_buffer(opts_.buffer_size);
+        flusher_ = std::thread(&FileWriter::flusher_loop, this);
+#endif
+    }
+
+    ~FileWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+            if (active_.size) {
+                pending_.push_back(active_);
+                active_.data = 0;
+                active_.size = 0;
+            }
+        }
+        flusher_cv_.notify_one();
+        flusher_.join();
+
+        close_file();
+        std::free(active_.data);
+        for (std::size_t i = 0; i < free_.size(); ++i)
+            std::free(free_[i].data);
+    }
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    template <typename... Args>
+    void write(const char* fmt, Args&&... args) {
+        detail::FormatOutput out;
+        format_message(out, fmt, std::forward<Args>(args)...);
+        append(out.data(), out.size());
+    }
+
+    template <typename... Args>
+    void writeln(const char* fmt, Args&&... args) {
+        detail::FormatOutput out;
+        format_message(out, fmt, std::forward<Args>(args)...);
+        out.append('\n');
+        append(out.data(), out.size());
+    }
+
+    // copy pre-formatted bytes; a message never straddles two buffers
+    void append(const char* data, std::size_t len) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (active_.size + len > active_.capacity) {
+            if (active_.size) queue_active(lock);
+            if (len > active_.capacity) {
+                detail::WriteBuffer big = detail::alloc_write_buffer(detail::round_to_pages(len));
+                std::memcpy(big.data, data, len);
+                big.size = len;
+                enqueue(lock, big);
+                return;
+            }
+        }
+        std::memcpy(active_.data + active_.size, data, len);
+        active_.size += len;
+    }
+
+    // block until everything appended so far has been written to the file
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (active_.size) queue_active(lock);
+        std::uint64_t target = queued_;
+        flusher_cv_.notify_one();
+        writer_cv_.wait(lock, [this, target]() { return written_ >= target; });
+    }
+
+    const std::string& path() const { return path_; }
+    bool failed() const { return failed_.load(std::memory_order_relaxed); }
+    unsigned rotations() const { return rotations_.load(std::memory_order_relaxed); }
+
+private:
+    template <typename... Args>
+    static void format_message(detail::OutputBase& out, const char* fmt, Args&&... args) {
+        detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+        detail::pack_args(arg_array, std::forward<Args>(args)...);
+        detail::format_to_impl(out, fmt, std::strlen(fmt), arg_array, sizeof...(Args));
+    }
+
+    void enqueue(std::unique_lock<std::mutex>& lock, const detail::WriteBuffer& b) {
+        writer_cv_.wait(lock, [this]() { return pending_.size() < opts_.max_pending; });
+        pending_.push_back(b);
+        ++queued_;
+        flusher_cv_.notify_one();
+    }
+
+    void queue_active(std::unique_lock<std::mutex>& lock) {
+        detail::WriteBuffer full = active_;
+        active_ = take_free();
+        enqueue(lock, full);
+    }
+
+    detail::WriteBuffer take_free() {
+        detail::WriteBuffer b;
+        if (!try_take_free(b)) throw std::bad_alloc();
+        return b;
+    }
+
+    bool try_take_free(detail::WriteBuffer& b) noexcept {
+        if (free_.empty()) return detail::try_alloc_write_buffer(opts_.buffer_size, b);
+        b = free_.back();
+        free_.pop_back();
+        return true;
+    }
+
+    void flusher_loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            if (pending_.empty() && !stop_) {
+                detail::WriteBuffer next;
+                // without memory for a fresh buffer the partial one waits
+                // for the next interval or writer
+                if (flusher_cv_.wait_for(lock, opts_.flush_interval) == std::cv_status::timeout &&
+                    pending_.empty() && active_.size && try_take_free(next)) {
+                    pending_.push_back(active_);
+                    ++queued_;
+                    active_ = next;
+                }
+            }
+            if (pending_.empty()) {
+                if (stop_) break;
+                continue;
+            }
+
+            batch_.swap(pending_);
+            writer_cv_.notify_all();
+            lock.unlock();
+
+            write_batch(batch_);
+
+            lock.lock();
+            written_ += batch_.size();
+            for (std::size_t i = 0; i < batch_.size(); ++i) {
+                if (batch_[i].capacity == opts_.buffer_size && free_.size() < opts_.max_pending) {
+                    batch_[i].size = 0;
+                    free_.push_back(batch_[i]);
+                } else {
+                    std::free(batch_[i].data);
+                }
+            }
+            batch_.clear();
+            writer_cv_.notify_all();
+        }
+    }
+
+    // runs on the flusher thread only, rotating between buffers
+    void write_batch(const std::vector<detail::WriteBuffer>& batch) {
+        enum { MAX_IOV = 64 };
+        struct iovec iov[MAX_IOV];
+        int count = 0;
+        std::size_t bytes = 0;
+
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            const detail::WriteBuffer& b = batch[i];
+            if (opts_.rotate_size && file_size_ + bytes > 0 &&
+                file_size_ + bytes + b.size > opts_.rotate_size) {
+                write_iov(iov, count, bytes);
+                count = 0;
+                bytes = 0;
+                rotate();
+            }
+            if (count == MAX_IOV) {
+                write_iov(iov, count, bytes);
+                count = 0;
+                bytes = 0;
+            }
+            iov[count].iov_base = b.data;
+            iov[count].iov_len = b.size;
+            ++count;
+            bytes += b.size;
+        }
+        write_iov(iov, count, bytes);
+    }
+
+    void write_iov(struct iovec* iov, int count, std::size_t bytes) {
+        if (count == 0 || fd_ < 0) return;
+        reserve_space(file_size_ + bytes);
+        while (count > 0) {
+            ssize_t n = ::writev(fd_, iov, count);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                failed_.store(true, std::memory_order_relaxed);
+                return;
+            }
+            file_size_ += static_cast<std::uint64_t>(n);
+            std::size_t left = static_cast<std::size_t>(n);
+            while (count > 0 && left >= iov->iov_len) {
+                left -= iov->iov_len;
+                ++iov;
+                --count;
+            }
+            if (count > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+                iov->iov_len -= left;
+            }
+        }
+    }
+
+    void reserve_space(std::uint64_t end) {
+#if defined(__linux__)
+        if (!opts_.preallocate || end <= allocated_) return;
+        std::uint64_t step = opts_.preallocate;
+        std::uint64_t target = (end + step - 1) / step * step;
+        if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(allocated_),
+                        static_cast<off_t>(target - allocated_)) == 0)
+            allocated_ = target;
+        else
+            opts_.preallocate = 0;   // unsupported by the filesystem
+#else
+        (void)end;
+#endif
+    }
+
+    void open_file() {
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            failed_.store(true, std::memory_order_relaxed);
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+            throw std::runtime_error("Vita::FileWriter: cannot open " + path_);
+#else
+            return;
+#endif
+        }
+        off_t end = ::lseek(fd_, 0, SEEK_END);
+        file_size_ = end > 0 ? static_cast<std::uint64_t>(end) : 0;
+        allocated_ = file_size_;
+    }
+
+    // release preallocated blocks past the end of the data
+    void close_file() {
+        if (fd_ < 0) return;
+        if (allocated_ > file_size_)
+            (void)::ftruncate(fd_, static_cast<off_t>(file_size_));
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    void rotate() {
+        close_file();
+        for (unsigned i = opts_.max_files; i > 1; --i) {
+            std::string from = path_ + "." + std::to_string(i - 1);
+            std::string to = path_ + "." + std::to_string(i);
+            std::rename(from.c_str(), to.c_str());
+        }
+        if (opts_.max_files > 0)
+            std::rename(path_.c_str(), (path_ + ".1").c_str());
+        else
+            std::remove(path_.c_str());
+
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (fd_ < 0) failed_.store(true, std::memory_order_relaxed);
+        file_size_ = 0;
+        allocated_ = 0;
+        rotations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string path_;
+    FileWriterOptions opts_;
+    int fd_;
+
+    std::mutex mutex_;
+    std::condition_variable flusher_cv_;
+    std::condition_variable writer_cv_;
+    detail::WriteBuffer active_;
+    std::vector<detail::WriteBuffer> pending_;
+    std::vector<detail::WriteBuffer> free_;
+    std::vector<detail::WriteBuffer> batch_;   // swapped with pending_ by the flusher
+    std::uint64_t queued_;
+    std::uint64_t written_;
+    bool stop_;
+
+    // owned by the flusher thread after construction
+    std::uint64_t file_size_;
+    std::uint64_t allocated_;
+
+    std::atomic<bool> failed_;
+    std::atomic<unsigned> rotations_;
+    std::thread flusher_;
+};
+
+} // namespace Vita
+
+#endif // VITA_FILE_WRITER_HPP
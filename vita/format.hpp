@@ -30,6 +30,7 @@
 #ifndef VITA_FORMAT_HPP
 #define VITA_FORMAT_HPP
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -46,21 +47,49 @@
 #define VITA_FORMAT_MAX_ARGS 32
 #endif
 
+// smaller inline output buffers, for fibers and coroutines with small stacks
+#ifndef VITA_FORMAT_SMALL_STACK
+#define VITA_FORMAT_SMALL_STACK 0
+#endif
+
 #ifndef VITA_FORMAT_SBO_SIZE
+#if VITA_FORMAT_SMALL_STACK
+#define VITA_FORMAT_SBO_SIZE 64
+#else
 #define VITA_FORMAT_SBO_SIZE 256
 #endif
+#endif
+
+// PASSTHROUGH copies string arguments as-is; SANITIZE replaces ill-formed
+// utf-8 with U+FFFD (the 'u' presentation does this per placeholder)
+#ifndef VITA_FORMAT_UTF8_POLICY
+#define VITA_FORMAT_UTF8_POLICY PASSTHROUGH
+#endif
+
+// count width and precision in display columns (wide CJK = 2) instead of code points
+#ifndef VITA_FORMAT_EAST_ASIAN_WIDTH
+#define VITA_FORMAT_EAST_ASIAN_WIDTH 0
+#endif
 
 #include "detail/output.hpp"
 #include "detail/int_to_str.hpp"
 #include "detail/float_to_str.hpp"
+#include "detail/escape.hpp"
+#include "detail/utf8.hpp"
 #include "detail/parse.hpp"
 #include "detail/compile_parse.hpp"
 #include "detail/ensure_fstring.hpp"
+#include "detail/max_size.hpp"
 
 #if !defined(VITA_FORMAT_NO_EXCEPTIONS)
 #include <stdexcept>
 #endif
 
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define VITA_FORMAT_HAS_STRING_VIEW 1
+#include <string_view>
+#endif
+
 namespace Vita {
 
 template <typename T, typename Enable = void>
@@ -73,7 +102,12 @@ class FormatArg {
 public:
     enum Type {
         NONE, BOOL, CHAR, INT, UINT, LLONG, ULLONG,
-        DOUBLE, LDOUBLE, CSTRING, STRING, POINTER, CUSTOM
+        DOUBLE, LDOUBLE, CSTRING, STRING, STRING_VIEW, POINTER, CUSTOM
+    };
+
+    struct StringView {
+        const char* data;
+        std::size_t size;
     };
 
     FormatArg() : type_(NONE) {}
@@ -100,6 +134,19 @@ public:
     FormatArg(char* v) : type_(CSTRING) { value_.cstring_val = v; }
     FormatArg(const std::string& v) : type_(STRING) { value_.string_val = &v; }
 
+    // characters that need not be NUL-terminated
+    FormatArg(const char* data, std::size_t size) : type_(STRING_VIEW) {
+        value_.view_val.data = data;
+        value_.view_val.size = size;
+    }
+
+#ifdef VITA_FORMAT_HAS_STRING_VIEW
+    FormatArg(std::string_view v) : type_(STRING_VIEW) {
+        value_.view_val.data = v.data();
+        value_.view_val.size = v.size();
+    }
+#endif
+
     template <std::size_t N>
     FormatArg(const char (&v)[N]) : type_(CSTRING) { value_.cstring_val = v; }
 
@@ -124,6 +171,7 @@ public:
     long double as_ldouble() const { return value_.ldouble_val; }
     const char* as_cstring() const { return value_.cstring_val; }
     const std::string* as_string() const { return value_.string_val; }
+    StringView as_view() const { return value_.view_val; }
     const void* as_pointer() const { return value_.pointer_val; }
 
 private:
@@ -139,45 +187,56 @@ private:
         long double ldouble_val;
         const char* cstring_val;
         const std::string* string_val;
+        StringView view_val;
         const void* pointer_val;
         Value() : pointer_val(0) {}
     } value_;
 };
 
-inline void apply_format_spec(FormatOutput& out, const char* content, std::size_t len, const FormatSpec& spec) {
-    if (spec.width <= 0 || len >= static_cast<std::size_t>(spec.width)) {
+inline void append_spec_fill(OutputBase& out, const FormatSpec& spec, std::size_t n) {
+    if (spec.fill_len == 1) {
+        out.append_fill(spec.fill, n);
+    } else {
+        char seq[4] = { spec.fill, spec.fill_tail[0], spec.fill_tail[1], spec.fill_tail[2] };
+        out.append_fill(seq, spec.fill_len, n);
+    }
+}
+
+// pad content, which occupies cols columns, out to spec.width
+inline void apply_padding(OutputBase& out, const char* content, std::size_t len,
+                          std::size_t cols, const FormatSpec& spec) {
+    if (spec.width <= 0 || cols >= static_cast<std::size_t>(spec.width)) {
         out.append(content, len);
         return;
     }
 
-    std::size_t padding = static_cast<std::size_t>(spec.width) - len;
-    char fill = spec.fill;
+    std::size_t padding = static_cast<std::size_t>(spec.width) - cols;
     char align = spec.align ? spec.align : '<';
 
     switch (align) {
     case '<':
         out.append(content, len);
-        out.append_fill(fill, padding);
+        append_spec_fill(out, spec, padding);
         break;
     case '>':
-        out.append_fill(fill, padding);
+        append_spec_fill(out, spec, padding);
         out.append(content, len);
         break;
     case '^': {
         std::size_t left_pad = padding / 2;
-        out.append_fill(fill, left_pad);
+        append_spec_fill(out, spec, left_pad);
         out.append(content, len);
-        out.append_fill(fill, padding - left_pad);
+        append_spec_fill(out, spec, padding - left_pad);
         break;
     }
     case '=':
         // sign-aware padding
         if (len > 0 && (content[0] == '-' || content[0] == '+' || content[0] == ' ')) {
             out.append(content[0]);
-            out.append_fill(fill, padding);
+            append_spec_fill(out, spec, padding);
             out.append(content + 1, len - 1);
         } else {
-            out.append_fill(fill, padding);
+            append_spec_fill(out, spec, padding);
             out.append(content, len);
         }
         break;
@@ -186,7 +245,65 @@ inline void apply_format_spec(FormatOutput& out, const char* content, std::size_
     }
 }
 
-inline void format_arg(FormatOutput& out, const FormatArg& arg, const FormatSpec& spec) {
+// width counts code points, so text is measured unless no padding can apply
+inline void apply_format_spec(OutputBase& out, const char* content, std::size_t len, const FormatSpec& spec) {
+    if (spec.width <= 0) {
+        out.append(content, len);
+        return;
+    }
+    apply_padding(out, content, len, text_width(content, len), spec);
+}
+
+// escaped presentations; the escaped length is only known after the copy,
+// so right and centre alignment, and any padding on a bounded output whose
+// window may be handed off mid-copy, stage the result in a scratch buffer
+inline void format_escaped(OutputBase& out, const char* str, std::size_t len,
+                           bool is_char, const FormatSpec& spec) {
+    EscapeMode mode = escape_mode(spec.type);
+    char align = spec.align ? spec.align : '<';
+
+    if (spec.width <= 0 || (align == '<' && !out.bounded())) {
+        std::size_t start = out.size();
+        if (is_char)
+            append_escaped_char(out, *str, mode);
+        else
+            append_escaped(out, str, len, mode);
+        std::size_t cols = spec.width > 0 ? text_width(out.data() + start, out.size() - start) : 0;
+        if (cols < static_cast<std::size_t>(spec.width))
+            append_spec_fill(out, spec, static_cast<std::size_t>(spec.width) - cols);
+        return;
+    }
+
+    FormatOutput tmp;
+    if (is_char)
+        append_escaped_char(tmp, *str, mode);
+    else
+        append_escaped(tmp, str, len, mode);
+    apply_format_spec(out, tmp.data(), tmp.size(), spec);
+}
+
+static const Utf8Policy utf8_policy = VITA_FORMAT_UTF8_POLICY;
+
+inline void format_string(OutputBase& out, const char* str, std::size_t len, const FormatSpec& spec) {
+    if ((utf8_policy == SANITIZE || spec.type == 'u') && !utf8_valid(str, len)) {
+        FormatOutput clean;
+        append_utf8_sanitized(clean, str, len);
+        // escape presentations still apply to the cleaned text
+        FormatSpec clean_spec = spec;
+        if (clean_spec.type == 'u') clean_spec.type = 's';
+        format_string(out, clean.data(), clean.size(), clean_spec);
+        return;
+    }
+
+    if (spec.precision >= 0 && static_cast<std::size_t>(spec.precision) < len)
+        len = text_prefix(str, len, static_cast<std::size_t>(spec.precision));
+    if (is_escape_type(spec.type))
+        format_escaped(out, str, len, false, spec);
+    else
+        apply_format_spec(out, str, len, spec);
+}
+
+inline void format_arg(OutputBase& out, const FormatArg& arg, const FormatSpec& spec) {
     char buffer[128];
     std::size_t len = 0;
 
@@ -201,7 +318,8 @@ inline void format_arg(FormatOutput& out, const FormatArg& arg, const FormatSpec
             len = 1;
         } else {
             const char* str = arg.as_bool() ? "true" : "false";
-            apply_format_spec(out, str, arg.as_bool() ? 4 : 5, spec);
+            std::size_t n = arg.as_bool() ? 4 : 5;
+            apply_padding(out, str, n, n, spec);
             return;
         }
         break;
@@ -220,6 +338,10 @@ inline void format_arg(FormatOutput& out, const FormatArg& arg, const FormatSpec
                 len = uint_to_bin(static_cast<unsigned>(val), buffer);
             else
                 len = int_to_str(val, buffer);
+        } else if (is_escape_type(spec.type)) {
+            char c = arg.as_char();
+            format_escaped(out, &c, 1, true, spec);
+            return;
         } else {
             buffer[0] = arg.as_char();
             len = 1;
@@ -377,25 +499,23 @@ inline void format_arg(FormatOutput& out, const FormatArg& arg, const FormatSpec
     case FormatArg::CSTRING: {
         const char* str = arg.as_cstring();
         if (!str) {
-            apply_format_spec(out, "(null)", 6, spec);
+            apply_padding(out, "(null)", 6, 6, spec);
             return;
         }
-        std::size_t str_len = std::strlen(str);
-        if (spec.precision >= 0 && static_cast<std::size_t>(spec.precision) < str_len)
-            str_len = static_cast<std::size_t>(spec.precision);
-        apply_format_spec(out, str, str_len, spec);
+        format_string(out, str, std::strlen(str), spec);
         return;
     }
 
     case FormatArg::STRING: {
         const std::string* str = arg.as_string();
-        std::size_t str_len = str->size();
-        if (spec.precision >= 0 && static_cast<std::size_t>(spec.precision) < str_len)
-            str_len = static_cast<std::size_t>(spec.precision);
-        apply_format_spec(out, str->data(), str_len, spec);
+        format_string(out, str->data(), str->size(), spec);
         return;
     }
 
+    case FormatArg::STRING_VIEW:
+        format_string(out, arg.as_view().data, arg.as_view().size, spec);
+        return;
+
     case FormatArg::POINTER:
         len = ptr_to_str(arg.as_pointer(), buffer);
         break;
@@ -409,17 +529,16 @@ inline void format_arg(FormatOutput& out, const FormatArg& arg, const FormatSpec
     FormatSpec adjusted_spec = spec;
     if (spec.zero_pad && spec.width > 0 && adjusted_spec.align == '\0') {
         adjusted_spec.fill = '0';
+        adjusted_spec.fill_len = 1;
         adjusted_spec.align = '=';
     }
 
-    apply_format_spec(out, buffer, len, adjusted_spec);
+    // numeric output is ascii, so its width is its length
+    apply_padding(out, buffer, len, len, adjusted_spec);
 }
 
-inline std::string format_impl(const char* fmt, std::size_t fmt_len,
-                               const FormatArg* args, std::size_t num_args) {
-    FormatOutput out;
-    out.reserve(fmt_len + num_args * 16);
-
+inline void format_to_impl(OutputBase& out, const char* fmt, std::size_t fmt_len,
+                           const FormatArg* args, std::size_t num_args) {
     FormatParser parser(fmt, fmt_len);
 
     for (;;) {
@@ -448,7 +567,7 @@ inline std::string format_impl(const char* fmt, std::size_t fmt_len,
             break;
 
         case ParseSegment::END:
-            return out.finish();
+            return;
 
         case ParseSegment::ERROR:
 #if !defined(VITA_FORMAT_NO_EXCEPTIONS)
@@ -459,10 +578,39 @@ inline std::string format_impl(const char* fmt, std::size_t fmt_len,
             break;
         }
     }
+}
 
+inline std::string format_impl(OutputBase& out, const char* fmt, std::size_t fmt_len,
+                               const FormatArg* args, std::size_t num_args) {
+    out.reserve(fmt_len + num_args * 16);
+    format_to_impl(out, fmt, fmt_len, args, num_args);
     return out.finish();
 }
 
+inline std::string format_impl(const char* fmt, std::size_t fmt_len,
+                               const FormatArg* args, std::size_t num_args) {
+    FormatOutput out;
+    return format_impl(out, fmt, fmt_len, args, num_args);
+}
+
+// recent output sizes of one call site, used as its next reservation. a
+// warm call site only loads it; it is stored, relaxed, when an output
+// outgrows it or when it is more than twice what outputs need, so it
+// tracks a decaying maximum without contention between threads
+struct SizeHint {
+    std::atomic<std::size_t> size;
+};
+
+inline void note_size(SizeHint& hint, std::size_t guess, std::size_t seen) {
+    if (seen > guess)
+        hint.size.store(seen + seen / 8, std::memory_order_relaxed);
+    else if (seen < guess / 2)
+        hint.size.store(guess - guess / 4, std::memory_order_relaxed);
+}
+
+inline std::string format_hinted_impl(SizeHint& hint, const char* fmt, std::size_t fmt_len,
+                                      const FormatArg* args, std::size_t num_args);
+
 inline void pack_args(FormatArg*) {}
 
 template <typename T, typename... Rest>
@@ -500,12 +648,15 @@ inline std::string format(const std::string& fmt) {
 }
 
 // formatc - compile-time optimized version
-// template instantiation per format string allows better inlining
+// template instantiation per format string allows better inlining; the
+// result is reserved from the sizes of earlier results of the same
+// instantiation and written straight into the returned string
 template <std::size_t N, typename... Args>
 std::string formatc(const char (&fmt)[N], Args&&... args) {
+    static detail::SizeHint hint;
     detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
     detail::pack_args(arg_array, std::forward<Args>(args)...);
-    return detail::format_impl(fmt, N - 1, arg_array, sizeof...(Args));
+    return detail::format_hinted_impl(hint, fmt, N - 1, arg_array, sizeof...(Args));
 }
 
 template <std::size_t N>
@@ -513,7 +664,446 @@ std::string formatc(const char (&fmt)[N]) {
     return detail::format_impl(fmt, N - 1, 0, 0);
 }
 
-#define VITA_FORMAT(fmt, ...) ::Vita::formatc(fmt, ##__VA_ARGS__)
+namespace detail {
+
+template <std::size_t N, typename... Args>
+std::string formatc_at(SizeHint& hint, const char (&fmt)[N], Args&&... args) {
+    FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    pack_args(arg_array, std::forward<Args>(args)...);
+    return format_hinted_impl(hint, fmt, N - 1, arg_array, sizeof...(Args));
+}
+
+} // namespace detail
+
+// like formatc, with the size hint kept per call site
+#define VITA_FORMAT(fmt, ...) \
+    ::Vita::detail::formatc_at([]() -> ::Vita::detail::SizeHint& { \
+        static ::Vita::detail::SizeHint hint; \
+        return hint; \
+    }(), fmt, ##__VA_ARGS__)
+
+// format_inline<N> - format with N bytes of inline output storage instead
+// of VITA_FORMAT_SBO_SIZE; small N keeps the stack frame small, larger N
+// keeps bigger messages off the heap
+template <std::size_t N, typename... Args>
+std::string format_inline(const char* fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    detail::InlineOutput<N> out;
+    return detail::format_impl(out, fmt, std::strlen(fmt), arg_array, sizeof...(Args));
+}
+
+template <std::size_t N, typename... Args>
+std::string format_inline(const std::string& fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    detail::InlineOutput<N> out;
+    return detail::format_impl(out, fmt.data(), fmt.size(), arg_array, sizeof...(Args));
+}
+
+// format_to - append to an existing output instead of returning a string
+template <typename... Args>
+void format_to(detail::OutputBase& out, const char* fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    detail::format_to_impl(out, fmt, std::strlen(fmt), arg_array, sizeof...(Args));
+}
+
+template <typename... Args>
+void format_to(detail::OutputBase& out, const std::string& fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    detail::format_to_impl(out, fmt.data(), fmt.size(), arg_array, sizeof...(Args));
+}
+
+namespace detail {
+
+// resize without caring about the new bytes, which are about to be written
+inline void resize_for_overwrite(std::string& s, std::size_t n) {
+#if defined(__cpp_lib_string_resize_and_overwrite)
+    s.resize_and_overwrite(n, [](char*, std::size_t len) { return len; });
+#else
+    s.resize(n);
+#endif
+}
+
+// output straight into the storage of a std::string past its current end;
+// the string is cut back to what was written on commit, and to its
+// original size if formatting throws
+class StringOutput : public OutputBase {
+public:
+    StringOutput(std::string& dst, std::size_t estimate)
+        : OutputBase(0, 0, &StringOutput::next_size), dst_(dst), base_(dst.size()), committed_(false)
+    {
+        resize_for_overwrite(dst_, base_ + estimate);
+        set_buffer(&dst_[0] + base_, estimate);
+    }
+
+    ~StringOutput() {
+        if (!committed_) dst_.resize(base_);
+    }
+
+    void commit() {
+        dst_.resize(base_ + size());
+        committed_ = true;
+    }
+
+private:
+    static void next_size(OutputBase& out, std::size_t need) {
+        StringOutput& self = static_cast<StringOutput&>(out);
+        std::size_t cap = self.capacity() + self.capacity() / 2;
+        if (cap < need) cap = need;
+        resize_for_overwrite(self.dst_, self.base_ + cap);
+        self.set_buffer(&self.dst_[0] + self.base_, cap);
+    }
+
+    std::string& dst_;
+    std::size_t base_;
+    bool committed_;
+};
+
+inline void format_append_impl(std::string& dst, const char* fmt, std::size_t fmt_len,
+                               const FormatArg* args, std::size_t num_args) {
+    StringOutput out(dst, fmt_len + num_args * 16);
+    format_to_impl(out, fmt, fmt_len, args, num_args);
+    out.commit();
+}
+
+// run write(OutputBase&) into a string reserved from hint
+template <typename Write>
+std::string format_hinted(SizeHint& hint, Write write) {
+    std::size_t guess = hint.size.load(std::memory_order_relaxed);
+    if (guess <= VITA_FORMAT_SBO_SIZE) {
+        // small outputs: the inline buffer and one exact copy are cheaper
+        // than writing into a string that has to be sized first
+        FormatOutput out;
+        write(out);
+        note_size(hint, guess, out.size());
+        return out.finish();
+    }
+
+    std::string result;
+    {
+        StringOutput out(result, guess);
+        write(out);
+        out.commit();
+    }
+    if (result.capacity() > std::string().capacity())
+        note_alloc(result.capacity() + 1, result.size() > guess);
+    note_size(hint, guess, result.size());
+    return result;
+}
+
+inline std::string format_hinted_impl(SizeHint& hint, const char* fmt, std::size_t fmt_len,
+                                      const FormatArg* args, std::size_t num_args) {
+    return format_hinted(hint, [=](OutputBase& out) {
+        format_to_impl(out, fmt, fmt_len, args, num_args);
+    });
+}
+
+} // namespace detail
+
+// format_append - format onto the end of dst, writing into its storage;
+// no argument may refer to dst
+template <typename... Args>
+void format_append(std::string& dst, const char* fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    detail::format_append_impl(dst, fmt, std::strlen(fmt), arg_array, sizeof...(Args));
+}
+
+template <typename... Args>
+void format_append(std::string& dst, const std::string& fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    detail::format_append_impl(dst, fmt.data(), fmt.size(), arg_array, sizeof...(Args));
+}
+
+// format_assign - replace the contents of dst, reusing its capacity; dst
+// is cleared first, so neither fmt nor any argument may refer to dst
+template <typename... Args>
+void format_assign(std::string& dst, const char* fmt, Args&&... args) {
+    dst.clear();
+    format_append(dst, fmt, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void format_assign(std::string& dst, const std::string& fmt, Args&&... args) {
+    dst.clear();
+    format_append(dst, fmt, std::forward<Args>(args)...);
+}
+
+// owning, NUL-terminated result of format_buffer; adopts the heap buffer
+// of a FormatOutput instead of copying it into a std::string
+class Buffer {
+public:
+    Buffer() noexcept : data_(0), size_(0), capacity_(0) {}
+
+    // takes the contents of out, leaving it empty; copies only when they
+    // still fit the small buffer
+    explicit Buffer(detail::OutputBase& out) : data_(0), size_(0), capacity_(0) {
+        out.append('\0');
+        size_ = out.size() - 1;
+        data_ = out.release(capacity_);
+        if (!data_) {
+            capacity_ = size_ + 1;
+            data_ = detail::heap_allocate(capacity_, false);
+            std::memcpy(data_, out.data(), size_ + 1);
+            out.shrink(out.size());
+        }
+    }
+
+    Buffer(Buffer&& other) noexcept
+        : data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+        other.data_ = 0;
+        other.size_ = 0;
+    }
+
+    Buffer& operator=(Buffer&& other) noexcept {
+        if (this != &other) {
+            if (data_) detail::heap_free(data_, capacity_);
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.data_ = 0;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    ~Buffer() {
+        if (data_) detail::heap_free(data_, capacity_);
+    }
+
+    const char* data() const noexcept { return data_ ? data_ : ""; }
+    const char* c_str() const noexcept { return data(); }
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    std::string str() const { return std::string(data(), size_); }
+#ifdef VITA_FORMAT_HAS_STRING_VIEW
+    operator std::string_view() const noexcept { return std::string_view(data(), size_); }
+#endif
+
+private:
+    char* data_;
+    std::size_t size_;
+    std::size_t capacity_;
+};
+
+namespace detail {
+
+inline Buffer format_buffer_impl(const char* fmt, std::size_t fmt_len,
+                                 const FormatArg* args, std::size_t num_args) {
+    FormatOutput out;
+    out.reserve(fmt_len + num_args * 16);
+    format_to_impl(out, fmt, fmt_len, args, num_args);
+    return Buffer(out);
+}
+
+} // namespace detail
+
+// format_buffer - like format, but the result owns the output buffer, so
+// output past the small buffer is never copied into a new string
+template <typename... Args>
+Buffer format_buffer(const char* fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    return detail::format_buffer_impl(fmt, std::strlen(fmt), arg_array, sizeof...(Args));
+}
+
+template <typename... Args>
+Buffer format_buffer(const std::string& fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    return detail::format_buffer_impl(fmt.data(), fmt.size(), arg_array, sizeof...(Args));
+}
+
+// result of format_view: NUL-terminated, valid until the next format_view
+// call on the same thread
+struct FormatView {
+    const char* data;
+    std::size_t size;
+
+    const char* c_str() const { return data; }
+    std::string str() const { return std::string(data, size); }
+#ifdef VITA_FORMAT_HAS_STRING_VIEW
+    operator std::string_view() const { return std::string_view(data, size); }
+#endif
+};
+
+namespace detail {
+
+// grow-only per-thread buffer; keeps its capacity between calls
+inline OutputBase& view_buffer() {
+    static thread_local FormatOutput out;
+    return out;
+}
+
+inline FormatView format_view_impl(const char* fmt, std::size_t fmt_len,
+                                   const FormatArg* args, std::size_t num_args) {
+    OutputBase& out = view_buffer();
+    out.shrink(out.size());
+    format_to_impl(out, fmt, fmt_len, args, num_args);
+    out.append('\0');
+    out.shrink(1);
+    FormatView view = { out.data(), out.size() };
+    return view;
+}
+
+} // namespace detail
+
+// format_view - format into a thread-local buffer instead of a new string
+template <typename... Args>
+FormatView format_view(const char* fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    return detail::format_view_impl(fmt, std::strlen(fmt), arg_array, sizeof...(Args));
+}
+
+template <typename... Args>
+FormatView format_view(const std::string& fmt, Args&&... args) {
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    return detail::format_view_impl(fmt.data(), fmt.size(), arg_array, sizeof...(Args));
+}
+
+// what format_fixed does with output that does not fit
+enum FixedOverflow {
+    FIXED_TRUNCATE, // keep what fits, set truncated
+    FIXED_THROW     // throw std::runtime_error (truncates with NO_EXCEPTIONS)
+};
+
+// result of format_fixed: inline, NUL-terminated, trivially copyable
+template <std::size_t N>
+struct FixedString {
+    char data[N + 1];
+    std::size_t size;
+    bool truncated;
+
+    FixedString() noexcept : size(0), truncated(false) { data[0] = '\0'; }
+
+    static constexpr std::size_t capacity() { return N; }
+    bool empty() const { return size == 0; }
+    const char* c_str() const { return data; }
+    std::string str() const { return std::string(data, size); }
+#ifdef VITA_FORMAT_HAS_STRING_VIEW
+    operator std::string_view() const { return std::string_view(data, size); }
+#endif
+
+    friend bool operator==(const FixedString& a, const FixedString& b) {
+        return a.size == b.size && std::memcmp(a.data, b.data, a.size) == 0;
+    }
+    friend bool operator!=(const FixedString& a, const FixedString& b) { return !(a == b); }
+};
+
+namespace detail {
+
+// output into a fixed buffer that never allocates; once the buffer is
+// full the rest of the output is discarded through the inline buffer
+class FixedOutput : public FormatOutput {
+public:
+    FixedOutput(char* buf, std::size_t capacity) noexcept
+        : FormatOutput(buf, capacity, &FixedOutput::discard), kept_(0), truncated_(false)
+    {
+        set_bounded(true);
+    }
+
+    bool truncated() const noexcept { return truncated_; }
+
+    // bytes of the caller's buffer holding output
+    std::size_t kept() const noexcept { return truncated_ ? kept_ : size(); }
+
+private:
+    // the first overflow keeps the buffer, cut back to a whole UTF-8
+    // sequence; later output only passes through the inline buffer
+    static void discard(OutputBase& out, std::size_t) {
+        FixedOutput& self = static_cast<FixedOutput&>(out);
+        if (!self.truncated_) {
+            self.truncated_ = true;
+            self.kept_ = whole_sequences(self.data(), self.size());
+            self.window_handed_off();
+            self.set_buffer(self.inline_buffer(), VITA_FORMAT_SBO_SIZE);
+            return;
+        }
+        self.window_handed_off();
+    }
+
+    static std::size_t whole_sequences(const char* s, std::size_t len) {
+        std::size_t i = len;
+        std::size_t cont = 0;
+        while (i > 0 && cont < 3 && (static_cast<unsigned char>(s[i - 1]) & 0xC0) == 0x80) {
+            --i;
+            ++cont;
+        }
+        if (i == 0) return len;
+        unsigned char lead = static_cast<unsigned char>(s[i - 1]);
+        if (lead >= 0xC0 && utf8_seq_len(lead) > cont + 1) return i - 1;
+        return len;
+    }
+
+    std::size_t kept_;
+    bool truncated_;
+};
+
+inline std::size_t format_fixed_impl(char* buf, std::size_t capacity, FixedOverflow policy,
+                                     bool& truncated, const char* fmt, std::size_t fmt_len,
+                                     const FormatArg* args, std::size_t num_args) {
+    FixedOutput out(buf, capacity);
+    format_to_impl(out, fmt, fmt_len, args, num_args);
+    std::size_t n = out.kept();
+    buf[n] = '\0';
+    truncated = out.truncated();
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+    if (truncated && policy == FIXED_THROW)
+        throw std::runtime_error("Vita::format_fixed: output exceeds capacity");
+#else
+    (void)policy;
+#endif
+    return n;
+}
+
+} // namespace detail
+
+// format_fixed - format into an inline buffer of N bytes, no allocation
+template <std::size_t N, FixedOverflow Policy = FIXED_TRUNCATE, typename... Args>
+FixedString<N> format_fixed(const char* fmt, Args&&... args) {
+    FixedString<N> result;
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    result.size = detail::format_fixed_impl(result.data, N, Policy, result.truncated,
+                                            fmt, std::strlen(fmt), arg_array, sizeof...(Args));
+    return result;
+}
+
+template <std::size_t N, FixedOverflow Policy = FIXED_TRUNCATE, typename... Args>
+FixedString<N> format_fixed(const std::string& fmt, Args&&... args) {
+    FixedString<N> result;
+    detail::FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    detail::pack_args(arg_array, std::forward<Args>(args)...);
+    result.size = detail::format_fixed_impl(result.data, N, Policy, result.truncated,
+                                            fmt.data(), fmt.size(), arg_array, sizeof...(Args));
+    return result;
+}
+
+#ifdef VITA_FORMAT_HAS_MAX_SIZE
+// max_formatted_size - compile-time upper bound on the length of
+// format(fmt, Args...); std::size_t(-1) when an argument is a string
+template <typename... Args, std::size_t N>
+constexpr std::size_t max_formatted_size(const char (&fmt)[N]) {
+    return detail::maxsz::Bound<detail::maxsz::TypeList<typename std::decay<Args>::type...> >::of(fmt);
+}
+
+// format_fixed into a buffer of exactly max_formatted_size bytes, so the
+// result is never truncated; strings are rejected at compile time
+#define VITA_FORMAT_SIZED(fmt, ...)                                              \
+    ::Vita::format_fixed< ::Vita::detail::maxsz::SizedCheck<                     \
+        ::Vita::detail::maxsz::Bound<decltype(                                   \
+            ::Vita::detail::maxsz::arg_types(__VA_ARGS__))>::of(fmt)>::value>(   \
+        fmt, ##__VA_ARGS__)
+#endif
 
 // Formatter extension point
 template <typename T, typename Enable>
@@ -524,7 +1114,7 @@ struct Formatter {
 
 template <typename T>
 struct Formatter<T, typename std::enable_if<std::is_enum<T>::value>::type> {
-    static void format(detail::FormatOutput& out, const T& value, const detail::FormatSpec& spec) {
+    static void format(detail::OutputBase& out, const T& value, const detail::FormatSpec& spec) {
         typedef typename std::underlying_type<T>::type underlying;
         detail::FormatArg arg(static_cast<underlying>(value));
         detail::format_arg(out, arg, spec);
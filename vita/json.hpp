@@ -0,0 +1,207 @@
+// vita/json.hpp - streaming JSON writer on top of FormatOutput
+//
+// Usage:
+//   Vita::JsonWriter w;
+//   w.begin_object().key("id").value(42).key("tags").begin_array()
+//    .value("a").value("b").end_array().end_object();
+//   std::string s = w.finish();   // {"id":42,"tags":["a","b"]}
+//
+// Nesting is checked with assert() in debug builds only.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_JSON_HPP
+#define VITA_JSON_HPP
+
+#include "format.hpp"
+
+#ifndef NDEBUG
+#include <cassert>
+#include <vector>
+#endif
+
+namespace Vita {
+
+class JsonWriter {
+public:
+    JsonWriter() : out_(&own_), need_comma_(false) {}
+
+    // append to an existing output instead of the internal buffer
+    explicit JsonWriter(detail::OutputBase& out) : out_(&out), need_comma_(false) {}
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& begin_object() {
+        before_value();
+        out_->append('{');
+        need_comma_ = false;
+#ifndef NDEBUG
+        stack_.push_back('{');
+        expect_key_ = true;
+#endif
+        return *this;
+    }
+
+    JsonWriter& end_object() {
+#ifndef NDEBUG
+        assert(!stack_.empty() && stack_.back() == '{' && "JsonWriter: end_object outside an object");
+        assert(expect_key_ && "JsonWriter: key without a value");
+        stack_.pop_back();
+#endif
+        out_->append('}');
+        after_value();
+        return *this;
+    }
+
+    JsonWriter& begin_array() {
+        before_value();
+        out_->append('[');
+        need_comma_ = false;
+#ifndef NDEBUG
+        stack_.push_back('[');
+#endif
+        return *this;
+    }
+
+    JsonWriter& end_array() {
+#ifndef NDEBUG
+        assert(!stack_.empty() && stack_.back() == '[' && "JsonWriter: end_array outside an array");
+        stack_.pop_back();
+#endif
+        out_->append(']');
+        after_value();
+        return *this;
+    }
+
+    JsonWriter& key(const char* k, std::size_t len) {
+#ifndef NDEBUG
+        assert(!stack_.empty() && stack_.back() == '{' && expect_key_ &&
+               "JsonWriter: key outside an object or twice in a row");
+        expect_key_ = false;
+#endif
+        if (need_comma_) out_->append(',');
+        append_string(k, len);
+        out_->append(':');
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& key(const char* k) { return key(k, std::strlen(k)); }
+    JsonWriter& key(const std::string& k) { return key(k.data(), k.size()); }
+
+    JsonWriter& value(const char* s, std::size_t len) {
+        before_value();
+        append_string(s, len);
+        after_value();
+        return *this;
+    }
+
+    JsonWriter& value(const char* s) {
+        if (!s) return null();
+        return value(s, std::strlen(s));
+    }
+
+    JsonWriter& value(const std::string& s) { return value(s.data(), s.size()); }
+    JsonWriter& value(char c) { return value(&c, 1); }
+
+    JsonWriter& value(bool b) {
+        before_value();
+        if (b) out_->append("true", 4);
+        else   out_->append("false", 5);
+        after_value();
+        return *this;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+                            !std::is_same<T, char>::value, JsonWriter&>::type
+    value(T v) {
+        char buffer[24];
+        std::size_t len = std::is_signed<T>::value
+            ? detail::int_to_str(static_cast<long long>(v), buffer)
+            : detail::uint_to_str(static_cast<unsigned long long>(v), buffer);
+        return raw_value(buffer, len);
+    }
+
+    // NaN and infinities have no JSON spelling and are written as null
+    JsonWriter& value(double d) {
+        detail::DoubleComponents c = detail::decompose_double(d);
+        if (c.is_nan || c.is_inf) return null();
+        char buffer[32];
+        std::size_t len = detail::double_to_str_shortest(d, buffer);
+        return raw_value(buffer, len);
+    }
+
+    JsonWriter& value(float f) { return value(static_cast<double>(f)); }
+
+    JsonWriter& null() { return raw_value("null", 4); }
+
+    // pre-serialised JSON, copied verbatim
+    JsonWriter& raw_value(const char* json, std::size_t len) {
+        before_value();
+        out_->append(json, len);
+        after_value();
+        return *this;
+    }
+
+    template <typename T>
+    JsonWriter& member(const char* k, const T& v) {
+        key(k);
+        return value(v);
+    }
+
+    detail::OutputBase& output() { return *out_; }
+
+    std::size_t size() const { return out_->size(); }
+
+    std::string finish() {
+#ifndef NDEBUG
+        assert(stack_.empty() && "JsonWriter: unclosed object or array");
+#endif
+        need_comma_ = false;
+        return out_->finish();
+    }
+
+private:
+    void before_value() {
+#ifndef NDEBUG
+        if (!stack_.empty() && stack_.back() == '{')
+            assert(!expect_key_ && "JsonWriter: value in an object needs a key");
+#endif
+        if (need_comma_) out_->append(',');
+    }
+
+    void after_value() {
+        need_comma_ = true;
+#ifndef NDEBUG
+        expect_key_ = true;
+#endif
+    }
+
+    void append_string(const char* s, std::size_t len) {
+        if (detail::utf8_policy == detail::SANITIZE && !detail::utf8_valid(s, len)) {
+            detail::FormatOutput clean;
+            detail::append_utf8_sanitized(clean, s, len);
+            out_->append('"');
+            detail::append_escaped(*out_, clean.data(), clean.size(), detail::ESCAPE_JSON);
+            out_->append('"');
+            return;
+        }
+        out_->append('"');
+        detail::append_escaped(*out_, s, len, detail::ESCAPE_JSON);
+        out_->append('"');
+    }
+
+    detail::FormatOutput own_;
+    detail::OutputBase* out_;
+    bool need_comma_;
+#ifndef NDEBUG
+    std::vector<char> stack_;
+    bool expect_key_ = true;
+#endif
+};
+
+} // namespace Vita
+
+#endif // VITA_JSON_HPP
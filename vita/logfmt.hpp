@@ -0,0 +1,152 @@
+// vita/logfmt.hpp - logfmt (key=value) structured log encoder
+//
+// Usage:
+//   Vita::detail::FormatOutput out;
+//   Vita::kv(out, "level", "info", "msg", message, "latency_ms", 3.2);
+//   // level=info msg="request done" latency_ms=3.2
+//
+//   static const Vita::KeySet<3> keys("level", "msg", "latency_ms");
+//   keys.write(out, "info", message, 3.2);
+//
+// Pairs are separated by a single space; a space is also written before
+// the first pair when the output already holds text. Keys are copied as
+// given and are expected to be plain identifiers.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_LOGFMT_HPP
+#define VITA_LOGFMT_HPP
+
+#include "format.hpp"
+
+namespace Vita {
+namespace detail {
+
+// strings are quoted when needed, everything else uses the default presentation
+inline void kv_value(OutputBase& out, const FormatArg& arg) {
+    switch (arg.type()) {
+    case FormatArg::CSTRING:
+        if (arg.as_cstring()) {
+            append_logfmt_value(out, arg.as_cstring(), std::strlen(arg.as_cstring()));
+            return;
+        }
+        break;
+    case FormatArg::STRING:
+        append_logfmt_value(out, arg.as_string()->data(), arg.as_string()->size());
+        return;
+    case FormatArg::STRING_VIEW:
+        append_logfmt_value(out, arg.as_view().data, arg.as_view().size);
+        return;
+    case FormatArg::CHAR: {
+        char c = arg.as_char();
+        append_logfmt_value(out, &c, 1);
+        return;
+    }
+    default:
+        break;
+    }
+    format_arg(out, arg, FormatSpec());
+}
+
+inline void kv_separator(OutputBase& out) {
+    if (out.written() != 0) out.append(' ');
+}
+
+// pre-rendered " key=" stored in a fixed-width slot so every key is
+// emitted with a constant-size copy
+struct KeySlot {
+    enum { WIDTH = 32 };
+    char text[WIDTH];
+    std::size_t len;
+    const char* key;    // keys too long for the slot are appended from here
+
+    KeySlot() : len(0), key(0) {}
+
+    void assign(const char* k) {
+        std::size_t n = std::strlen(k);
+        key = k;
+        len = n + 2;
+        if (len <= WIDTH) {
+            std::memset(text, 0, WIDTH);
+            text[0] = ' ';
+            std::memcpy(text + 1, k, n);
+            text[n + 1] = '=';
+        }
+    }
+
+    void write(OutputBase& out, bool first) const {
+        if (len <= WIDTH) {
+            char* p = out.grow(WIDTH);
+            std::memcpy(p, text, WIDTH);
+            out.shrink(WIDTH - len);
+            if (first) {
+                // drop the leading space written with the slot
+                char* start = p;
+                std::memmove(start, start + 1, len - 1);
+                out.shrink(1);
+            }
+        } else {
+            if (!first) out.append(' ');
+            out.append(key, len - 2);
+            out.append('=');
+        }
+    }
+};
+
+} // namespace detail
+
+inline void kv(detail::OutputBase&) {}
+
+template <std::size_t N, typename T, typename... Rest>
+inline void kv(detail::OutputBase& out, const char (&key)[N], const T& value, Rest&&... rest) {
+    detail::kv_separator(out);
+    out.append(key, N - 1);
+    out.append('=');
+    detail::kv_value(out, detail::FormatArg(value));
+    kv(out, std::forward<Rest>(rest)...);
+}
+
+// logfmt line as a std::string
+template <typename... Args>
+inline std::string logfmt(Args&&... args) {
+    detail::FormatOutput out;
+    kv(out, std::forward<Args>(args)...);
+    return out.finish();
+}
+
+// reusable set of keys for a fixed record shape
+template <std::size_t N>
+class KeySet {
+public:
+    template <typename... Keys>
+    explicit KeySet(Keys... keys) {
+        static_assert(sizeof...(Keys) == N, "Vita::KeySet - key count does not match N");
+        const char* list[N] = { keys... };
+        for (std::size_t i = 0; i < N; ++i)
+            slots_[i].assign(list[i]);
+    }
+
+    template <typename... Values>
+    void write(detail::OutputBase& out, const Values&... values) const {
+        static_assert(sizeof...(Values) == N, "Vita::KeySet - value count does not match key count");
+        detail::FormatArg args[N] = { detail::FormatArg(values)... };
+        for (std::size_t i = 0; i < N; ++i) {
+            slots_[i].write(out, out.written() == 0);
+            detail::kv_value(out, args[i]);
+        }
+    }
+
+    template <typename... Values>
+    std::string format(const Values&... values) const {
+        detail::FormatOutput out;
+        write(out, values...);
+        return out.finish();
+    }
+
+private:
+    detail::KeySlot slots_[N];
+};
+
+} // namespace Vita
+
+#endif // VITA_LOGFMT_HPP
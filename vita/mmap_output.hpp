@@ -0,0 +1,200 @@
+// vita/mmap_output.hpp - format straight into a memory-mapped file
+//
+// Usage:
+//   Vita::MmapOutput out("export.csv");
+//   for (const Row& r : rows)
+//       Vita::format_to(out, "{},{},{:.3f}\n", r.id, r.name, r.score);
+//   out.close();                     // truncates to the bytes written
+//
+// MmapOutput is a FormatOutput whose storage is a shared mapping of the
+// file. When it fills, the file is extended and the mapping enlarged by
+// chunk_size bytes (mremap on Linux, so nothing is copied), which keeps
+// multi-gigabyte exports free of the grow-and-copy cycle of a heap buffer
+// and of the second copy made by write(2). With non_temporal set, output
+// is staged in a STREAM_WINDOW byte window that is copied into the mapping
+// with non-temporal stores whenever it fills, so the exported bytes bypass
+// the cache; the output is then bounded and data() covers only the window.
+//
+// POSIX only.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_MMAP_OUTPUT_HPP
+#define VITA_MMAP_OUTPUT_HPP
+
+#include <cstdlib>
+
+#include "format.hpp"
+#include "detail/pages.hpp"
+#include "detail/simd.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace Vita {
+
+class MmapOutput : public detail::OutputBase {
+public:
+    enum { STREAM_WINDOW = 64 << 10 };
+
+    explicit MmapOutput(const std::string& path, std::size_t chunk_size = std::size_t(64) << 20,
+                        bool non_temporal = false)
+        : OutputBase(0, 0, non_temporal ? &MmapOutput::stream_window : &MmapOutput::grow_mapping),
+          fd_(-1), map_(0), mapped_(0), chunk_(detail::round_to_pages(chunk_size)),
+          window_(0), window_cap_(0), streamed_(0)
+    {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) fail("Vita::MmapOutput: cannot open " + path);
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+        try {
+            start(non_temporal);
+        } catch (...) {
+            discard();
+            delete[] window_;
+            throw;
+        }
+#else
+        start(non_temporal);
+#endif
+    }
+
+    ~MmapOutput() {
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+        try {
+            close();
+        } catch (...) {
+            discard();
+        }
+#else
+        close();
+#endif
+        delete[] window_;
+    }
+
+    MmapOutput(const MmapOutput&) = delete;
+    MmapOutput& operator=(const MmapOutput&) = delete;
+
+    // unmap and cut the file to the formatted size; returns that size
+    std::size_t close() {
+        if (fd_ >= 0 && window_) stream_out();
+        std::size_t n = written();
+        if (fd_ < 0) return n;
+        if (map_) ::munmap(map_, mapped_);
+        map_ = 0;
+        mapped_ = 0;
+        set_buffer(0, 0);
+        if (::ftruncate(fd_, static_cast<off_t>(n)) != 0) {
+            ::close(fd_);
+            fd_ = -1;
+            fail("Vita::MmapOutput: truncate failed");
+        }
+        ::close(fd_);
+        fd_ = -1;
+        return n;
+    }
+
+    bool is_open() const noexcept { return fd_ >= 0; }
+
+private:
+    void start(bool non_temporal) {
+        if (non_temporal) {
+            window_ = new char[STREAM_WINDOW];
+            detail::note_alloc(STREAM_WINDOW, false);
+            window_cap_ = STREAM_WINDOW;
+            set_buffer(window_, window_cap_);
+            set_bounded(true);
+        }
+        remap(chunk_);
+    }
+
+    // unmap and close without truncating, for paths that cannot throw
+    void discard() noexcept {
+        if (map_) ::munmap(map_, mapped_);
+        map_ = 0;
+        mapped_ = 0;
+        set_buffer(0, 0);
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    static void grow_mapping(OutputBase& out, std::size_t need) {
+        MmapOutput& self = static_cast<MmapOutput&>(out);
+        if (self.fd_ < 0) fail("Vita::MmapOutput: write after close");
+        self.remap(self.round_to_chunks(need));
+    }
+
+    // contiguous requests (grow) larger than the window get a larger window
+    static void stream_window(OutputBase& out, std::size_t need) {
+        MmapOutput& self = static_cast<MmapOutput&>(out);
+        if (self.fd_ < 0) fail("Vita::MmapOutput: write after close");
+        std::size_t extra = need - self.size();
+        self.stream_out();
+        if (extra > self.window_cap_) {
+            char* bigger = new char[extra];
+            detail::note_alloc(extra, false);
+            delete[] self.window_;
+            self.window_ = bigger;
+            self.window_cap_ = extra;
+            self.set_buffer(bigger, extra);
+        }
+    }
+
+    // copy the window to the end of the file, past the cache
+    void stream_out() {
+        std::size_t n = size();
+        if (n == 0) return;
+        if (streamed_ + n > mapped_) remap(round_to_chunks(streamed_ + n));
+        detail::stream_copy(map_ + streamed_, data(), n);
+        streamed_ += n;
+        window_handed_off();
+    }
+
+    std::size_t round_to_chunks(std::size_t n) const noexcept {
+        return (n + chunk_ - 1) / chunk_ * chunk_;
+    }
+
+    void remap(std::size_t cap) {
+        if (::ftruncate(fd_, static_cast<off_t>(cap)) != 0)
+            fail("Vita::MmapOutput: cannot extend file");
+
+        void* p;
+        if (!map_) {
+            p = ::mmap(0, cap, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        } else {
+#if defined(__linux__)
+            p = ::mremap(map_, mapped_, cap, MREMAP_MAYMOVE);
+#else
+            ::munmap(map_, mapped_);
+            map_ = 0;
+            if (!window_) set_buffer(0, 0);
+            p = ::mmap(0, cap, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+#endif
+        }
+        if (p == MAP_FAILED) fail("Vita::MmapOutput: cannot map file");
+        map_ = static_cast<char*>(p);
+        mapped_ = cap;
+        if (!window_) set_buffer(map_, cap);
+    }
+
+    static void fail(const std::string& msg) {
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+        throw std::runtime_error(msg);
+#else
+        (void)msg;
+        std::abort();
+#endif
+    }
+
+    int fd_;
+    char* map_;
+    std::size_t mapped_;
+    std::size_t chunk_;
+    char* window_;          // staging window when non_temporal, else null
+    std::size_t window_cap_;
+    std::size_t streamed_;  // bytes copied from the window into the mapping
+};
+
+} // namespace Vita
+
+#endif // VITA_MMAP_OUTPUT_HPP
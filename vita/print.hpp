@@ -0,0 +1,112 @@
+// vita/print.hpp - format straight to a FILE* or file descriptor
+//
+// Usage:
+//   Vita::print("{} items\n", n);              // stdout
+//   Vita::println(stderr, "error: {}", msg);   // FILE*, newline appended
+//   Vita::print(fd, "{}\n", value);            // file descriptor
+//
+// The message is formatted into FormatOutput's inline buffer (heap only
+// beyond VITA_FORMAT_SBO_SIZE) and handed over in one call: a single
+// fwrite, which holds the stream lock for the whole line, or a single
+// write(2) for descriptors. Lines from concurrent threads do not interleave.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_PRINT_HPP
+#define VITA_PRINT_HPP
+
+#include <cerrno>
+#include <cstdio>
+
+#include "format.hpp"
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace Vita {
+namespace detail {
+
+inline void print_error() {
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+    throw std::runtime_error("Vita::print: write failed");
+#endif
+}
+
+inline void write_file(std::FILE* f, const char* data, std::size_t len) {
+    if (len != 0 && std::fwrite(data, 1, len, f) != len)
+        print_error();
+}
+
+// one write(2) per message; the loop only runs again after a short write
+// or a signal interruption
+inline void write_fd(int fd, const char* data, std::size_t len) {
+    while (len > 0) {
+#if defined(_WIN32)
+        int n = ::_write(fd, data, static_cast<unsigned>(len));
+#else
+        ssize_t n = ::write(fd, data, len);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            print_error();
+            return;
+        }
+        data += n;
+        len -= static_cast<std::size_t>(n);
+    }
+}
+
+template <typename... Args>
+inline void print_to(OutputBase& out, bool newline, const char* fmt, Args&&... args) {
+    FormatArg arg_array[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    pack_args(arg_array, std::forward<Args>(args)...);
+    format_to_impl(out, fmt, std::strlen(fmt), arg_array, sizeof...(Args));
+    if (newline) out.append('\n');
+}
+
+} // namespace detail
+
+template <typename... Args>
+void print(std::FILE* f, const char* fmt, Args&&... args) {
+    detail::FormatOutput out;
+    detail::print_to(out, false, fmt, std::forward<Args>(args)...);
+    detail::write_file(f, out.data(), out.size());
+}
+
+template <typename... Args>
+void println(std::FILE* f, const char* fmt, Args&&... args) {
+    detail::FormatOutput out;
+    detail::print_to(out, true, fmt, std::forward<Args>(args)...);
+    detail::write_file(f, out.data(), out.size());
+}
+
+template <typename... Args>
+void print(int fd, const char* fmt, Args&&... args) {
+    detail::FormatOutput out;
+    detail::print_to(out, false, fmt, std::forward<Args>(args)...);
+    detail::write_fd(fd, out.data(), out.size());
+}
+
+template <typename... Args>
+void println(int fd, const char* fmt, Args&&... args) {
+    detail::FormatOutput out;
+    detail::print_to(out, true, fmt, std::forward<Args>(args)...);
+    detail::write_fd(fd, out.data(), out.size());
+}
+
+template <typename... Args>
+void print(const char* fmt, Args&&... args) {
+    print(stdout, fmt, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void println(const char* fmt, Args&&... args) {
+    println(stdout, fmt, std::forward<Args>(args)...);
+}
+
+} // namespace Vita
+
+#endif // VITA_PRINT_HPP
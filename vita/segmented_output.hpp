@@ -0,0 +1,157 @@
+// vita/segmented_output.hpp - output as a chain of fixed-size chunks
+//
+// Usage:
+//   Vita::SegmentedOutput out;
+//   for (const Row& r : rows)
+//       Vita::format_to(out, "{},{},{:.3f}\n", r.id, r.name, r.score);
+//   std::vector<iovec> iov = out.iovecs();
+//   writev(fd, iov.data(), static_cast<int>(iov.size()));
+//
+// SegmentedOutput is a FormatOutput that never moves what it has written.
+// When the current chunk fills, it is closed and writing continues in a new
+// chunk, so a large output costs one allocation per chunk and no copying,
+// and peak memory is the output plus one chunk rather than 2.5 times the
+// output. The result is read as a list of segments (iovecs() on POSIX,
+// for_each_segment() anywhere) or copied once into one block by flatten().
+// clear() keeps the chunks on a free list for the next output.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_SEGMENTED_OUTPUT_HPP
+#define VITA_SEGMENTED_OUTPUT_HPP
+
+#include <vector>
+
+#include "format.hpp"
+
+#if !defined(_WIN32)
+#include <sys/uio.h>
+#endif
+
+namespace Vita {
+
+class SegmentedOutput : public detail::OutputBase {
+public:
+    explicit SegmentedOutput(std::size_t chunk_size = std::size_t(64) << 10)
+        : OutputBase(0, 0, &SegmentedOutput::next_chunk),
+          chunk_size_(chunk_size ? chunk_size : 1), current_(0)
+    {
+        set_bounded(true);
+    }
+
+    ~SegmentedOutput() {
+        for (std::size_t i = 0; i < chain_.size(); ++i)
+            delete[] chain_[i].data;
+        for (std::size_t i = 0; i < free_.size(); ++i)
+            delete[] free_[i];
+        delete[] current_;
+    }
+
+    SegmentedOutput(const SegmentedOutput&) = delete;
+    SegmentedOutput& operator=(const SegmentedOutput&) = delete;
+
+    // bytes written across all chunks
+    std::size_t total() const noexcept { return written(); }
+
+    std::size_t segment_count() const noexcept {
+        return chain_.size() + (size() > 0 ? 1 : 0);
+    }
+
+    // f(const char* data, std::size_t len) for each segment in order
+    template <typename F>
+    void for_each_segment(F f) const {
+        for (std::size_t i = 0; i < chain_.size(); ++i)
+            f(static_cast<const char*>(chain_[i].data), chain_[i].size);
+        if (size() > 0) f(data(), size());
+    }
+
+    // copy the output into dst, which must hold total() bytes
+    void flatten(char* dst) const {
+        for_each_segment([&dst](const char* p, std::size_t n) {
+            std::memcpy(dst, p, n);
+            dst += n;
+        });
+    }
+
+    std::string flatten() const {
+        std::string result(total(), '\0');
+        if (!result.empty()) flatten(&result[0]);
+        return result;
+    }
+
+#if !defined(_WIN32)
+    // the segments for writev/sendmsg; valid until the next write or clear
+    std::vector<struct iovec> iovecs() const {
+        std::vector<struct iovec> iov;
+        iov.reserve(segment_count());
+        for_each_segment([&iov](const char* p, std::size_t n) {
+            struct iovec v;
+            v.iov_base = const_cast<char*>(p);
+            v.iov_len = n;
+            iov.push_back(v);
+        });
+        return iov;
+    }
+#endif
+
+    // drop the output; chunks go to the free list for reuse
+    void clear() {
+        for (std::size_t i = 0; i < chain_.size(); ++i)
+            recycle(chain_[i].data, chain_[i].capacity);
+        chain_.clear();
+        restart();
+    }
+
+private:
+    struct Segment {
+        char* data;
+        std::size_t size;
+        std::size_t capacity;
+    };
+
+    // close the full chunk and continue in a fresh one; contiguous
+    // requests (grow) larger than a chunk get a chunk of their own size
+    static void next_chunk(detail::OutputBase& out, std::size_t need) {
+        SegmentedOutput& self = static_cast<SegmentedOutput&>(out);
+        std::size_t extra = need - self.size();
+        std::size_t cap = extra > self.chunk_size_ ? extra : self.chunk_size_;
+        self.chain_.reserve(self.chain_.size() + 1);
+
+        char* chunk;
+        if (cap == self.chunk_size_ && !self.free_.empty()) {
+            chunk = self.free_.back();
+            self.free_.pop_back();
+        } else {
+            chunk = new char[cap];
+            detail::note_alloc(cap, false);
+        }
+
+        if (self.current_) {
+            if (self.size() > 0) {
+                Segment seg = { self.current_, self.size(), self.capacity() };
+                self.chain_.push_back(seg);
+            } else {
+                self.recycle(self.current_, self.capacity());
+            }
+        }
+        self.current_ = chunk;
+        self.window_handed_off();
+        self.set_buffer(chunk, cap);
+    }
+
+    void recycle(char* chunk, std::size_t capacity) {
+        if (capacity == chunk_size_)
+            free_.push_back(chunk);
+        else
+            delete[] chunk;
+    }
+
+    std::size_t chunk_size_;
+    char* current_;
+    std::vector<Segment> chain_;
+    std::vector<char*> free_;
+};
+
+} // namespace Vita
+
+#endif // VITA_SEGMENTED_OUTPUT_HPP
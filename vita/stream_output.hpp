@@ -0,0 +1,90 @@
+// vita/stream_output.hpp - bounded-memory output that streams to a sink
+//
+// Usage:
+//   Vita::StreamOutput out([&](const char* data, std::size_t len) {
+//       send_all(sock, data, len);
+//   });
+//   Vita::format_to(out, "{}:{}\n", key, huge_blob);
+//   out.flush();
+//
+// StreamOutput is a FormatOutput with a fixed window (VITA_FORMAT_SBO_SIZE
+// bytes by default). Whenever the window fills, its contents are handed to
+// the sink and writing continues at the start of the window; appends and
+// padding larger than the window go out in window-sized pieces. Peak memory
+// stays at the window size whatever the size of the output. Bytes still in
+// the window reach the sink on flush() or destruction.
+//
+// MIT License - Copyright (c) 2022-2025 Can Onur Topal
+
+#ifndef VITA_STREAM_OUTPUT_HPP
+#define VITA_STREAM_OUTPUT_HPP
+
+#include <functional>
+
+#include "format.hpp"
+
+namespace Vita {
+
+class StreamOutput : public detail::OutputBase {
+public:
+    typedef std::function<void(const char* data, std::size_t len)> Sink;
+
+    explicit StreamOutput(Sink sink, std::size_t window = VITA_FORMAT_SBO_SIZE)
+        : OutputBase(0, 0, &StreamOutput::next_window),
+          sink_(sink), window_(new char[window ? window : 1]), flushed_(0)
+    {
+        detail::note_alloc(window ? window : 1, false);
+        set_buffer(window_, window ? window : 1);
+        set_bounded(true);
+    }
+
+    ~StreamOutput() {
+#if !defined(VITA_FORMAT_NO_EXCEPTIONS)
+        try {
+            flush();
+        } catch (...) {
+        }
+#else
+        flush();
+#endif
+        delete[] window_;
+    }
+
+    StreamOutput(const StreamOutput&) = delete;
+    StreamOutput& operator=(const StreamOutput&) = delete;
+
+    // hand the bytes in the window to the sink
+    void flush() {
+        if (size() == 0) return;
+        std::size_t n = size();
+        sink_(data(), n);
+        window_handed_off();
+        flushed_ += n;
+    }
+
+    // bytes written so far, including those already handed to the sink
+    std::size_t total() const noexcept { return flushed_ + size(); }
+
+private:
+    // contiguous requests (grow) larger than the window get a larger window
+    static void next_window(OutputBase& out, std::size_t need) {
+        StreamOutput& self = static_cast<StreamOutput&>(out);
+        std::size_t extra = need - self.size();
+        self.flush();
+        if (extra > self.capacity()) {
+            char* bigger = new char[extra];
+            detail::note_alloc(extra, false);
+            delete[] self.window_;
+            self.window_ = bigger;
+            self.set_buffer(bigger, extra);
+        }
+    }
+
+    Sink sink_;
+    char* window_;
+    std::size_t flushed_;
+};
+
+} // namespace Vita
+
+#endif // VITA_STREAM_OUTPUT_HPP